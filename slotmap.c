@@ -1,68 +1,576 @@
 // slotmap.c
 // Persistent classroom booking system with booking/cancel history
-// Files: users.txt, rooms.txt, bookings.txt (all in text format)
+// Files: users.txt (text), rooms.dat, bookings.dat, calendar.dat (binary)
+// Legacy rooms.txt and bookings.txt are migrated on first load
 
+#ifdef _WIN32
+#define _CRT_RAND_S // rand_s() for password salts
+#else
+#define _DEFAULT_SOURCE // madvise(), strcasecmp() and usleep() under -std=c11
+#endif
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <ctype.h>
 #include <errno.h>
-#include <conio.h> // getch()
+#include <time.h>
+#include <sys/stat.h>
 #ifdef _WIN32
+#include <conio.h>   // _getch()
 #include <windows.h> // for colored output
+#include <io.h>      // _commit(), _isatty()
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004 // missing from older SDKs
+#endif
+#else
+#include <unistd.h>  // fsync()
+#include <termios.h> // raw keyboard input
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/ioctl.h> // terminal size
+#include <sys/mman.h>  // mapped text files
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+// gcc/clang atomics let server threads update schedule words lock-free
+#if defined(__GNUC__) || defined(__clang__)
+#define SLOTMAP_ATOMICS 1
 #endif
 
 // ----------------------------
 // 1. Data Structures
 // ----------------------------
+#define PASSWORD_HASH_LEN 128 // "$pbkdf2-sha256$<iterations>$<salt hex>$<hash hex>"
+
 typedef struct {
     int id;
     char department[20];
     char type[10];        // "lab" or "general" (store lowercase)
-    bool schedule[7][24]; // false = available, true = booked
+    uint32_t schedule[7]; // bit h of day d set = booked, clear = available
+    int dept_id;          // interned department, see intern_name()
+    int type_id;          // interned type
 } Classroom;
 
 typedef struct {
     char username[50];
-    char password[50];
+    char password[PASSWORD_HASH_LEN]; // hash_password() string, or legacy plaintext
     bool is_admin;
 } User;
 
+// SHA-256 state for password hashing
+typedef struct {
+    uint32_t state[8];
+    uint8_t block[64];
+    size_t block_len;     // bytes waiting in block
+    uint64_t total_len;   // bytes hashed so far
+} Sha256;
+
 typedef struct {
     int room_id;
     int day;              // 0-6
     int hour;             // 0-23
     char username[50];    // who performed the action
     char action;          // 'B' = BOOK, 'C' = CANCEL
+    int hours;            // length of a range booking, 1 for a single slot
+    int day_mask;         // bit d set for every day the record covers
+    int user;             // index into users[], HISTORY_NAME_USER(k), or -1 if unknown
+    int64_t timestamp;    // seconds since the epoch, 0 if not recorded
+    int flags;            // LOG_FLAG_*
+    int week;             // calendar week of a dated booking, 0 = every week
 } BookingRecord;
 
+typedef struct {
+    int user;             // index into users[], -1 if the name is unknown
+    char action;          // last logged action for the slot, 0 = none
+    int active_pos;       // position in the booker's UserBookings::active while 'B'
+} SlotAction;
+
+typedef struct {
+    long record;          // bookings.dat record number
+    bool by_other;        // someone else cancelled this user's booking
+} HistoryRef;
+
+// Per-user view of the log, kept in step with slot_history
+typedef struct {
+    int *active;          // slot keys (see slot_key()) this user holds now
+    int active_count;
+    int active_capacity;
+    HistoryRef *history;  // records that concern this user, in log order
+    int history_count;
+    int history_capacity;
+    int *interval_rooms;  // ascending room indexes where this user made sub-hour weekly bookings
+    int interval_room_count;
+    int interval_room_capacity;
+} UserBookings;
+
+// On-disk layout of rooms.dat (native byte order)
+#define ROOMS_DB_MAGIC   "SLMR"
+#define ROOMS_DB_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size; // sizeof(RoomRecord), guards against layout changes
+    uint32_t room_count;
+} RoomsFileHeader;
+
+typedef struct {
+    int32_t id;
+    char department[20];
+    char type[10];
+    char reserved[2];
+    uint32_t schedule[7];
+} RoomRecord;
+
+// One slot change in rooms.wal
+typedef struct {
+    int32_t room_id;
+    uint8_t day;          // 0-6, or WAL_DAY_SET | mask of days
+    uint8_t hour;         // first hour
+    uint8_t booked;       // bit 0: 1 = booked, 0 = freed; bits 1-5: hours (0 = 1)
+    uint8_t check;        // detects a torn record at the tail
+} WalRecord;
+
+#define WAL_DAY_SET 0x80  // WalRecord::day holds a day mask
+
+// A day word copied under the locks by a server checkpoint
+typedef struct {
+    int room_index;
+    int day;
+    uint32_t word;
+} DayWordCopy;
+
+// On-disk layout of bookings.dat: a header, then one record per action
+#define BOOKINGS_DB_MAGIC   "SLMB"
+#define BOOKINGS_DB_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_size; // sizeof(BookingLogRecord)
+    uint32_t reserved;
+} BookingsFileHeader;
+
+typedef struct {
+    int64_t timestamp;    // seconds since the epoch; bookings.txt mtime if migrated
+    int32_t room_id;
+    int32_t user_id;      // index into users[], HISTORY_NAME_USER(k) for history_names[k], -1 if unknown
+    uint8_t day;          // first day in day_mask
+    uint8_t hour;
+    uint8_t hours;
+    uint8_t day_mask;
+    char action;          // 'B' = BOOK, 'C' = CANCEL
+    uint8_t flags;        // LOG_FLAG_*
+    uint16_t week;        // calendar week of a dated booking (see parse_date()), 0 = every week
+} BookingLogRecord;
+
+#define HISTORY_NAME_USER(k) (-2 - (k)) // user id of a name found only in old history
+#define LOG_FLAG_SNAPSHOT 0x01 // current owner carried over by a compaction
+#define LOG_FLAG_QUARTERS 0x02 // hour and hours count quarter-hours: a sub-hour booking
+
+// Archived history: a header, then (from version 2) the segment's LogTally,
+// then delta + varint encoded records
+#define ARCHIVE_MAGIC   "SLMA"
+#define ARCHIVE_VERSION 2
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t record_count;
+    uint32_t reserved;
+    int64_t first_time;   // oldest and newest timestamps in the segment
+    int64_t last_time;
+} ArchiveHeader;
+
+// Slot-hours booked and cancelled per day/hour by the events in a stretch
+// of the log; snapshot records are never counted
+typedef struct {
+    int64_t booked[7][24];
+    int64_t cancelled[7][24];
+    int64_t records;
+} LogTally;
+
+// Decodes one loaded segment in order
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t left;        // records not yet decoded
+    int64_t timestamp;    // previous record, the base for the next delta
+    int64_t room_id;
+    int64_t user_id;
+} ArchiveCursor;
+
+// One of the viewer's bookings while the archives are replayed, so that a
+// cancellation by someone else can be shown to the owner it displaced
+typedef struct {
+    int room_id;
+    int week;
+    int day;
+    int start;            // minutes of the day
+    int end;
+} ArchivedSpan;
+
+#define LOG_READ_BATCH 256 // records fetched per fread while streaming
+
+// Streams bookings.dat from a given record number
+typedef struct {
+    FILE *fp;
+    BookingLogRecord buf[LOG_READ_BATCH];
+    int count;            // records in buf
+    int pos;              // next record in buf
+    long next;            // record number of buf[pos]
+    long end;             // whole records present when opened
+} BookingLogReader;
+
+// A whole file mapped read-only, or copied into memory where mapping fails
+typedef struct {
+    const char *data;
+    size_t size;
+    bool mapped;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} MappedFile;
+
+// users.txt, rooms.txt or bookings.txt scanned in place; tokens point into
+// the mapping, nothing is copied
+typedef struct {
+    const char *path;
+    MappedFile file;
+    const char *pos;
+    const char *end;
+    int line;             // 1-based line of pos, for error messages
+} TextScanner;
+
+typedef void (*WorkerTask)(void *arg);
+
+// A previous owner told about a cancellation, found by a replay worker
+typedef struct {
+    long record;
+    int user;
+} ReplayNotice;
+
+// One startup replay thread: first it resolves a chunk of records, then it
+// replays the weekly records of every room in its stripe
+typedef struct {
+    const BookingLogRecord *records; // the mapped log
+    int *room_of;         // per record: room index, REPLAY_UNKNOWN_ROOM or REPLAY_INVALID
+    long total;
+    long first, end;      // this worker's chunk
+    int stripe, stripes;  // rooms with room_index % stripes == stripe
+    ReplayNotice *notices; // in record order
+    int notice_count;
+    int notice_capacity;
+    bool failed;
+} ReplayWorker;
+
+// One sub-hour booking, in minutes from Sunday 00:00 of its week
+typedef struct {
+    int start;
+    int end;              // exclusive
+    int user;             // index into users[], -1 if unknown
+} Interval;
+
+// Sub-hour bookings of a room (weekly) or of a room in one calendar week,
+// sorted by start and never overlapping, so every lookup is a binary search
+typedef struct {
+    Interval *items;
+    int count;
+    int capacity;
+} IntervalIndex;
+
+// Who holds one dated slot
+typedef struct {
+    uint8_t day;
+    uint8_t hour;
+    int user;             // index into users[], -1 if unknown
+} CalendarOwner;
+
+// Dated bookings of one room in one calendar week (Sunday to Saturday)
+typedef struct {
+    int room_index;
+    int week;
+    uint32_t schedule[7]; // bit h of day d set = booked on that date
+    CalendarOwner *owners; // one per booked slot, unordered
+    int owner_count;
+    int owner_capacity;
+    IntervalIndex intervals; // sub-hour bookings on these dates
+    int next_in_room;     // next week of the same room in calendar_weeks, -1 = none
+} CalendarWeek;
+
+// On-disk layout of calendar.dat: weeks that have ended, moved out of memory
+#define CALENDAR_MAGIC   "SLMC"
+#define CALENDAR_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    int32_t evicted_before; // every week before this one is in the file
+    uint32_t week_count;
+} CalendarFileHeader;
+
+typedef struct {
+    int32_t room_id;
+    int32_t week;
+    uint32_t schedule[7];
+} CalendarWeekRecord;
+
+// One booked dated slot or interval, for the listings
+typedef struct {
+    int room_index;
+    int week;
+    int day;
+    int start;            // minutes from midnight
+    int end;
+    int user;
+} DatedSlot;
+
+typedef struct {
+    int *slots;           // table index + 1, 0 = empty
+    int capacity;         // power of two
+    int used;
+} HashIndex;
+
+#define NAME_KEY_LEN 20   // fits Classroom::department and ::type
+
+typedef struct {
+    char (*names)[NAME_KEY_LEN]; // lowercased spellings, indexed by id
+    int count;
+    int capacity;
+} NameTable;
+
+typedef struct {
+    int dept_id;
+    int type_id;
+    int *members;         // room indexes in table order
+    int count;
+    int capacity;
+} RoomGroup;
+
+// Outcome of a booking operation, shared by the menus and batch mode
+typedef enum {
+    OP_OK,
+    OP_OK_UNLOGGED,       // applied, but the history record was not written
+    OP_SLOT_TAKEN,
+    OP_SLOT_FREE,
+    OP_NOT_OWNER,
+    OP_SAVE_FAILED,
+    OP_DATE_PASSED
+} OpStatus;
+
+typedef struct {
+    int user_index;       // acting account, -1 until selected
+    int booked;
+    int cancelled;
+    int searches;
+    int rooms_added;
+    int failed;
+} CommandSession;
+
+// Filter for the free-window finder; -1 in a filter field means "any"
+typedef struct {
+    int dept_id;
+    int type_id;
+    int floor;            // rooms[].id / 100
+    int day_mask;         // days to search, bit d = day d
+    int hours;            // contiguous free hours needed
+    bool first_only;      // only the earliest window per room and day
+} WindowQuery;
+
+typedef struct {
+    int room_index;
+    int day;
+    int hour;             // first hour of the window
+} FreeWindow;
+
+// Utilization figures from one pass over the schedule and one over the log
+typedef struct {
+    int rooms_booked[7][24];     // live schedule: rooms booked per day/hour
+    long logged_booked[7][24];   // log: slot-hours booked per day/hour
+    long logged_cancelled[7][24];
+    long log_records;
+    long booked_hours;           // live schedule, whole campus
+    int *room_hours;             // booked hours per room index
+    long *dept_hours;            // per department id
+    int *dept_rooms;
+    int *floor_ids;              // distinct floors (room id / 100), ascending
+    long *floor_hours;           // per entry of floor_ids
+    int *floor_rooms;
+    int floor_count;
+} CampusStats;
+
+// A color change at `offset` in a Screen's text
+typedef struct {
+    size_t offset;
+    int color;
+} ColorRun;
+
+// One listing rendered in memory and written out in a single call. On a
+// terminal that understands ANSI the colors are escape sequences inside the
+// text; on a classic Windows console they are only the runs, applied at flush.
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+    ColorRun *runs;       // every color change, in text order
+    int run_count;
+    int run_capacity;
+    int color;            // color for the next text
+    int emitted;          // color the text ends in
+    bool ansi;            // write escape sequences into the text
+    bool console;         // record ColorRuns for SetConsoleTextAttribute
+    bool failed;          // out of memory, the text is truncated
+} Screen;
+
 // ----------------------------
 // 2. Globals & File Paths
 // ----------------------------
-#define MAX_ROOMS 100
-#define MAX_USERS 100
-
-Classroom rooms[MAX_ROOMS];
-User users[MAX_USERS];
+#define TABLE_MIN_CAPACITY 64 // first allocation for the room and user tables
+#define HASH_MIN_CAPACITY  128 // smallest hash index slot array
+
+#define WAL_SYNC_BATCH          8   // fsync the WAL every N records
+#define WAL_CHECKPOINT_INTERVAL 256 // fold the WAL into rooms.dat every N records
+
+#define LOG_INDEX_BLOCK 256 // bookings.dat records per sparse time index entry
+#define LOG_COMPACT_THRESHOLD 1000000 // compact automatically at startup past this many records
+#define ARCHIVE_BUFFER_SIZE 65536     // encoder output buffer
+#define CALENDAR_EPOCH_DAYS 3 // 1970-01-04, the Sunday that starts calendar week 0
+
+#define SCREEN_MIN_CAPACITY 16384 // first allocation for a rendered Screen
+#define SCREEN_DEFAULT_ROWS 25    // page height when the terminal size is unknown
+
+// About 0.2 s per hash: with three of four cores hashing, a 500-login burst
+// at semester start clears in about 30 s while bookings keep a core
+#define PASSWORD_DEFAULT_ITERATIONS 200000 // PBKDF2 cost for new hashes, see --hash-cost
+#define PASSWORD_MIN_ITERATIONS     1000   // lowest --hash-cost, for slow hosts
+#define PASSWORD_SALT_LEN 16
+
+#define COMMAND_REPLY_LEN 4096  // longest reply to a batch command
+#define ROOM_LOCK_STRIPES 256   // server mode: rooms share this many mutexes
+#define SERVER_BACKLOG    64
+#define MAX_WORKER_THREADS 16   // startup replay: most threads used, see --threads
+#define REPLAY_PARALLEL_MIN 65536 // smaller logs replay faster on one thread
+#define DEFAULT_FLUSH_DELAY_MS 200  // server mode: table rewrites coalesce this long, see --flush-delay
+#define MAX_FLUSH_DELAY_MS   60000
+
+#define DAY_MASK 0xFFFFFFu        // the 24 hour bits of a schedule word
+#define MINUTES_PER_DAY 1440
+#define DEFAULT_SLOT_MINUTES 15   // finest booking step; see --slot-minutes
+#define ROOM_SET_WORDS(n) (((n) + 63) / 64) // words in a one-bit-per-room set
+
+Classroom *rooms = NULL;
+User *users = NULL;
+SlotAction (*slot_history)[7][24] = NULL; // last action per slot, by room index
+UserBookings *user_bookings = NULL;       // parallel to users[]
+uint8_t *room_dirty_days = NULL;          // days changed since the last checkpoint
 int room_count = 0;
 int user_count = 0;
+char (*history_names)[50] = NULL; // names in old history with no account (User::username size)
+int history_name_count = 0;
+int history_name_capacity = 0;
+int room_capacity = 0;
+int user_capacity = 0;
+HashIndex room_id_index = {0};  // rooms[].id -> room index
+HashIndex username_index = {0}; // users[].username -> user index
+
+NameTable department_names = {0};
+NameTable room_type_names = {0};
+RoomGroup *room_groups = NULL;  // one per (department, type) pair in use
+int room_group_count = 0;
+int room_group_capacity = 0;
 int current_user_index = -1;
 
 const char *USERS_FILE    = "users.txt";
 const char *ROOMS_FILE    = "rooms.txt";
-const char *BOOKINGS_FILE = "bookings.txt";
+const char *ROOMS_DB_FILE = "rooms.dat";
+const char *ROOMS_WAL_FILE = "rooms.wal";
+const char *ROOMS_WAL_OLD_FILE = "rooms.wal.old"; // log of a checkpoint still being written
+
+FILE *wal_fp = NULL;
+int wal_records = 0;   // records since the last checkpoint
+int wal_unsynced = 0;  // records since the last fsync
+FILE *booking_log_fp = NULL;
+long log_record_count = 0;        // records in bookings.dat
+int64_t *log_block_times = NULL;  // per LOG_INDEX_BLOCK records: newest timestamp up to its first
+int log_block_count = 0;
+int log_block_capacity = 0;
+int64_t log_max_time = 0;         // newest timestamp seen so far
+int archive_segments = 0;         // bookings.NNN.arc files, numbered from 1
+LogTally archive_tally = {0};  // events in all archive segments
+LogTally log_tally = {0};      // events in bookings.dat; appends add under the log lock
+
+CalendarWeek **calendar_weeks = NULL; // weeks with dated bookings, in memory
+int calendar_week_count = 0;
+int calendar_week_capacity = 0;
+HashIndex calendar_index = {0};   // (room index, week) -> calendar_weeks index
+int *room_calendar = NULL;        // per room index: first of its calendar_weeks, -1 = none
+int calendar_evicted_before = 0;  // weeks before this live in calendar.dat
+IntervalIndex *room_intervals = NULL; // per room index: weekly sub-hour bookings
+int slot_minutes = DEFAULT_SLOT_MINUTES; // booking times and lengths are multiples of this
+int worker_threads = 0;                  // startup replay threads, 0 = one per CPU
+
+bool defer_writes = false;       // batch mode: flush once at the end
+bool rooms_layout_dirty = false; // rooms.dat needs a full rewrite (rooms were added)
+bool users_dirty = false;        // users.txt needs rewriting
+int flush_delay_ms = DEFAULT_FLUSH_DELAY_MS;
+bool serving = false;            // server threads are running
+int stdout_terminal = -1;        // is_terminal(stdout), checked on first use
+#ifndef _WIN32
+struct termios saved_termios;    // terminal settings to restore after raw input
+bool raw_input = false;          // stdin is in non-canonical, no-echo mode
+#endif
+#ifndef _WIN32
+pthread_mutex_t room_locks[ROOM_LOCK_STRIPES];
+pthread_mutex_t booking_log_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t users_lock = PTHREAD_MUTEX_INITIALIZER; // password upgrades while serving
+pthread_mutex_t calendar_lock = PTHREAD_MUTEX_INITIALIZER; // calendar_weeks and calendar_index
+pthread_mutex_t wal_lock = PTHREAD_MUTEX_INITIALIZER;      // rooms.wal appends and checkpoints
+pthread_mutex_t persist_lock = PTHREAD_MUTEX_INITIALIZER;  // dirty flags and the flusher
+pthread_cond_t persist_wake = PTHREAD_COND_INITIALIZER;
+pthread_mutex_t hashing_lock = PTHREAD_MUTEX_INITIALIZER;  // hashing_slots
+pthread_cond_t hashing_done = PTHREAD_COND_INITIALIZER;
+int hashing_slots = 1;           // server mode: logins that may hash at once
+bool flusher_running = false;    // server mode: a thread rewrites dirty tables and checkpoints
+bool flusher_stop = false;
+bool checkpoint_due = false;     // server mode: rooms.wal passed WAL_CHECKPOINT_INTERVAL
+#endif
+int password_iterations = PASSWORD_DEFAULT_ITERATIONS;
+const char *BOOKINGS_FILE = "bookings.dat";
+const char *BOOKINGS_TEXT_FILE = "bookings.txt";
+const char *BOOKINGS_NAMES_FILE = "bookings.names";
+const char *BOOKINGS_ARCHIVE_PREFIX = "bookings";
+const char *CALENDAR_FILE = "calendar.dat";
 
 const char *days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
 
 // Function Prototypes
 bool parse_ampm_input(const char* input, int* hour24);
+bool parse_time_input(const char *input, int *minute);
+bool parse_duration(const char *input, int *minutes);
 void hour_to_ampm(int hour24, char* output);
-bool validate_hour(int hour);
+void minute_to_ampm(int minute, char *output);
+void format_minute_range(int start, int end, char *out, size_t size);
+void record_minutes(int hour, int hours, int flags, int *start, int *end);
+bool valid_booking_span(int start, int end);
 void pause_and_clear();
 void to_lower_case(char *str);
 int  str_casecmp(const char *a, const char *b);
 int validate_day(const char *dayStr);
+bool parse_day_list(const char *text, int *day_mask);
+void format_day_list(int day_mask, char *out, size_t size);
+void format_booking_days(int week, int day_mask, char *out, size_t size);
+void format_hour_range(int hour, int hours, char *out, size_t size);
+void format_record_when(const BookingRecord *rec, char *out, size_t size);
 bool validate_room_type(const char *type);
 bool validate_room_id(int id);
 
@@ -70,40 +578,316 @@ void user_menu();
 void admin_menu();
 void register_user();
 bool login();
-void get_search_input(char *dept, int *day, int *hour, char *type);
+void get_search_input(char *dept, int *week, int *day, int *minute, char *type);
 void search_classrooms();
+bool room_matches_query(int room_index, const WindowQuery *query);
+int  find_free_windows(const WindowQuery *query, FreeWindow *out, int limit);
+int  find_campus_windows(const WindowQuery *query, FreeWindow *out, int limit);
+bool parse_window_filters(const char *dept, const char *type, const char *floor, WindowQuery *query);
+void find_free_window();
 int  find_room_by_id(int room_id);
+int  find_user_by_name(const char *username);
 void book_slot();
 void cancel_booking();
 void add_classroom();
 void view_all_bookings();
 void my_bookings();
 
+// Utilization analytics
+bool collect_campus_stats(CampusStats *stats);
+void tally_log_record(LogTally *tally, char action, int day_mask, int hour, int hours, int flags);
+bool add_archive_tally(int segment, LogTally *tally);
+void free_campus_stats(CampusStats *stats);
+double utilization_pct(long booked, long rooms_in_scope, int hours_per_room);
+void print_utilization_report(FILE *out, const CampusStats *stats);
+bool write_utilization_csv(const char *path, const CampusStats *stats);
+void utilization_report();
+int  run_analytics(const char *csv_path);
+void print_all_bookings(Screen *out);
+void print_my_bookings(Screen *out, int user_index);
+
 void initialize_sample_data();
 void ensure_data_loaded_or_initialized();
 bool file_exists(const char *path);
 
+// Password hashing
+void sha256_init(Sha256 *ctx);
+void sha256_compress(uint32_t state[8], const uint8_t block[64]);
+void sha256_update(Sha256 *ctx, const void *data, size_t len);
+void sha256_final(Sha256 *ctx, uint8_t digest[32]);
+void pbkdf2_sha256(const char *password, const uint8_t *salt, size_t salt_len,
+                   int iterations, uint8_t out[32]);
+bool random_bytes(uint8_t *out, size_t len);
+bool constant_time_equal(const void *a, const void *b, size_t len);
+bool hash_password(const char *password, int iterations, char *out, size_t size);
+bool verify_password(const char *stored, const char *password, bool *needs_rehash);
+int  authenticate(const char *username, const char *password);
+void begin_hashing();
+void end_hashing();
+void lock_users();
+void unlock_users();
+
+// Text scanner for the text formats
+bool map_file(MappedFile *file, const char *path);
+void unmap_file(MappedFile *file);
+bool open_text_scanner(TextScanner *scan, const char *path);
+void close_text_scanner(TextScanner *scan);
+bool scan_error(TextScanner *scan, const char *what);
+void scan_skip_space(TextScanner *scan);
+bool scan_at_line_end(TextScanner *scan);
+void scan_next_line(TextScanner *scan);
+bool scan_int(TextScanner *scan, int *out);
+size_t scan_word(TextScanner *scan, const char **word);
+bool scan_word_into(TextScanner *scan, char *out, size_t size);
+bool is_scan_space(char c);
+
 // Text file operations
+FILE *open_replacement(const char *path, char *temp, size_t size, const char *mode);
+bool replace_file(const char *temp, const char *path);
+bool commit_replacement(FILE *fp, const char *temp, const char *path, bool ok);
 bool save_users();
 bool load_users();
 bool save_rooms();
+bool write_room_day(FILE *fp, int room_index, int day);
+bool write_room_word(FILE *fp, int room_index, int day, uint32_t word);
 bool load_rooms();
-bool append_booking_record_with_action(int room_id, int day, int hour, const char *username, char action);
+bool load_rooms_text();
+bool migrate_rooms_text();
+
+// Write-ahead log for slot changes
+bool sync_file(FILE *fp);
+bool open_rooms_wal();
+bool wal_append(int room_index, int day, int hour, bool booked);
+bool wal_append_range(int room_index, int day_mask, int hour, int hours, bool booked);
+bool checkpoint_rooms();
+void lock_wal();
+void unlock_wal();
+void request_checkpoint();
+bool checkpoint_rooms_while_serving();
+bool rotate_rooms_wal();
+bool append_file(const char *from, const char *to);
+int  replay_rooms_wal();
+int  replay_wal_file(const char *path);
+void close_rooms_wal();
+
+// Binary booking log
+bool open_booking_log();
+void close_booking_log();
+long write_log_record(const BookingLogRecord *rec);
+bool index_log_record(int64_t timestamp);
+long first_log_record_since(int64_t since);
+bool open_log_reader(BookingLogReader *reader, long first_record);
+const BookingLogRecord *next_raw_log_record(BookingLogReader *reader);
+bool next_log_record(BookingLogReader *reader, BookingRecord *out);
+void close_log_reader(BookingLogReader *reader);
+bool migrate_bookings_text();
+bool load_history_names();
+bool save_history_names();
+int  add_history_name(const char *username);
+int  log_user(int64_t user_id);
+const char *user_display_name(int user);
+int  export_booking_log(const char *path, int max_age_days);
+bool append_booking_record_with_action(int room_id, int day, int hour, int user_index, char action);
+bool append_booking_range_record(int room_id, int day_mask, int hour, int hours, int user_index, char action);
+bool scan_booking_line(TextScanner *scan, BookingRecord *rec);
+bool next_booking_text_record(TextScanner *scan, BookingRecord *rec);
 bool get_last_slot_action(int room_id, int day, int hour, char *out_username, char *out_action, bool *found);
+bool get_last_slot_action_at(int room_index, int day, int hour, char *out_username, char *out_action, bool *found);
+void record_slot_action(int room_id, int day, int hour, int user_index, char action, long record);
+void record_range_action(int room_id, int day_mask, int hour, int hours, int user_index, char action, long record);
+bool build_slot_history_index();
+void reset_replay_state();
+void replay_log_record(const BookingLogRecord *rec, long record);
+bool log_record_valid(const BookingLogRecord *rec);
+
+// Parallel startup replay
+int  cpu_count();
+void run_in_parallel(WorkerTask task, void *args, size_t arg_size, int count);
+long mapped_log_records(const MappedFile *log);
+void resolve_replay_chunk(void *arg);
+void replay_room_stripe(void *arg);
+bool replay_log_in_parallel(const MappedFile *log, long total, int workers);
+bool read_log_record_at(BookingLogReader *reader, long record, BookingRecord *out);
+
+// Per-user booking index
+int  slot_key(int room_index, int day, int hour);
+bool add_active_slot(int user_index, int key);
+void drop_active_slot(int user_index, int pos);
+bool add_user_history(int user_index, long record, bool by_other);
+bool add_interval_room(int user_index, int room_index);
+void reset_user_bookings();
+int  compare_ints(const void *a, const void *b);
+
+// Log compaction and archives
+void archive_path(int segment, char *out, size_t size);
+int  count_archive_segments();
+size_t put_varint(uint8_t *out, uint64_t value);
+bool get_varint(ArchiveCursor *cursor, uint64_t *value);
+long archived_log_prefix();
+long write_archive_segment(const char *path, long skip);
+bool write_interval_snapshot(FILE *fp, int room_id, int week, const IntervalIndex *index, long *kept);
+bool write_log_snapshot(const char *path, long *kept);
+bool compact_booking_log(long *archived, long *kept);
+uint8_t *load_archive_segment(int segment, ArchiveHeader *header, ArchiveCursor *cursor);
+bool next_archive_record(ArchiveCursor *cursor, BookingRecord *out);
+bool records_equal(const BookingRecord *a, const BookingRecord *b);
+bool track_archived_span(ArchivedSpan **spans, int *count, int *capacity,
+                         const BookingRecord *rec, int user_index);
+void print_archived_history(Screen *out, int user_index);
+void offer_archived_history(int user_index);
+void compact_history();
 
 void set_text_color(int color);
+
+// Keyboard input
+bool enter_raw_input();
+void leave_raw_input();
+int  read_key();
+int  get_key();
 void get_password(char *password, size_t maxlen);
+bool read_line(char *buf, size_t size);
+int  read_menu_choice();
+
+// Screen output
+bool is_terminal(FILE *fp);
+bool stdout_is_terminal();
+int  terminal_rows();
+void clear_screen();
+void screen_open(Screen *screen, FILE *out);
+void screen_close(Screen *screen);
+void screen_printf(Screen *screen, const char *format, ...);
+void screen_color(Screen *screen, int color);
+bool screen_reserve(Screen *screen, size_t extra);
+int  ansi_color_code(int color);
+void screen_sync_color(Screen *screen);
+void screen_write(Screen *screen, FILE *out, size_t from, size_t to, int *run);
+void screen_flush(Screen *screen, FILE *out, bool paged);
+
+// Table storage
+bool reserve_rooms(int needed);
+bool reserve_users(int needed);
+size_t grown_capacity(int capacity, int needed, size_t item_size);
+bool grow_array(void **items, int *capacity, int needed, size_t item_size);
+uint64_t *alloc_room_set();
+
+// Hash indexes
+bool rebuild_room_index();
+bool rebuild_user_index();
+bool index_room(int room_index);
+bool index_user(int user_index);
+
+// Department/type index
+int  lookup_name(const NameTable *table, const char *name);
+int  intern_name(NameTable *table, const char *name);
+RoomGroup *find_room_group(int dept_id, int type_id);
+bool group_room(int room_index);
+bool rebuild_room_groups();
+
+// Booking operations
+void lock_room(int room_index);
+void unlock_room(int room_index);
+bool claim_slot(Classroom *room, int day, int hour, bool booked);
+bool claim_window(Classroom *room, int day, uint32_t window);
+OpStatus book_slot_as(int room_index, int day, int hour, int user_index);
+OpStatus book_range_as(int room_index, int day_mask, int hour, int hours, int user_index);
+OpStatus cancel_slot_as(int room_index, int day, int hour, int user_index);
+int  create_classroom(int id, const char *dept, const char *type);
+bool persist_rooms();
+bool persist_users();
+void lock_persist();
+void unlock_persist();
+bool request_flush();
+bool flush_dirty_tables();
+bool flush_deferred_writes();
+
+// Calendar (dated bookings)
+int  days_from_civil(int year, int month, int day);
+void civil_from_days(int days, int *year, int *month, int *day);
+bool parse_date(const char *text, int *week, int *day);
+void format_date(int week, int day, char *out, size_t size);
+void today_in_weeks(int *week, int *day);
+bool date_has_passed(int week, int day);
+void lock_calendar();
+void unlock_calendar();
+uint32_t hash_calendar_key(int room_index, int week);
+bool rebuild_calendar_index();
+CalendarWeek *lookup_calendar_week(int room_index, int week);
+CalendarWeek *find_calendar_week(int room_index, int week);
+CalendarWeek *get_calendar_week(int room_index, int week);
+int  calendar_owner(const CalendarWeek *cw, int day, int hour);
+void set_calendar_owner(CalendarWeek *cw, int day, int hour, int user);
+void reset_calendar();
+void record_dated_action(int room_id, int week, int day, int hour, int hours, int user_index, char action, long record);
+bool append_dated_record(int room_id, int week, int day, int hour, int hours, int user_index, char action);
+OpStatus book_date_as(int room_index, int week, int day, int hour, int hours, int user_index);
+OpStatus cancel_date_as(int room_index, int week, int day, int hour, int user_index);
+bool find_dated_conflict(int room_index, int day_mask, int start, int end,
+                         int *out_week, int *out_day, int *out_minute);
+bool dated_bits_for_day(int week, int day, uint32_t *bits);
+DatedSlot *collect_dated_slots(int user_index, int *count);
+int  compare_dated_slots(const void *a, const void *b);
+bool load_calendar_header();
+long evict_past_weeks();
+
+// Interval index (sub-hour bookings)
+int  interval_floor(const IntervalIndex *index, int minute);
+int  interval_containing(const IntervalIndex *index, int minute);
+int  interval_overlap(const IntervalIndex *index, int start, int end);
+bool interval_insert(IntervalIndex *index, int start, int end, int user);
+void interval_remove(IntervalIndex *index, int pos);
+uint32_t hours_touched(int start, int end);
+uint32_t interval_day_hours(const IntervalIndex *index, int day);
+uint32_t room_busy_hours(int room_index, int day);
+bool room_free_for(int room_index, int week, int day, int start, int end);
+bool room_dated_free_for(int room_index, int week, int day, int start, int end);
+bool room_free_at(int room_index, int week, int day, int minute);
+void record_interval_action(int room_id, int week, int day_mask, int start, int end, int user_index, char action, long record);
+bool append_interval_record(int room_id, int week, int day_mask, int start, int end, int user_index, char action);
+OpStatus book_interval_as(int room_index, int week, int day_mask, int start, int end, int user_index);
+OpStatus cancel_interval_as(int room_index, int week, int day, int minute, int user_index);
+OpStatus book_minutes_as(int room_index, int week, int day_mask, int start, int end, int user_index);
+OpStatus cancel_minutes_as(int room_index, int week, int day, int minute, int user_index);
+bool find_booking_conflict(int room_index, int week, int day_mask, int start, int end,
+                           int *out_week, int *out_day, int *out_minute, int *out_user);
+
+// Batch mode
+double now_seconds();
+const char *op_status_message(OpStatus status);
+bool parse_slot_args(const char *args, int *room_index, int *week, int *day, int *minute,
+                     char *reply, size_t reply_size);
+bool parse_range_args(const char *args, int *room_index, int *week, int *day_mask, int *start,
+                      int *end, char *reply, size_t reply_size);
+bool execute_command(const char *line, CommandSession *session, char *reply, size_t reply_size);
+bool is_query_command(const char *line);
+int  run_batch(const char *path);
+
+// Server mode
+int  run_server(const char *endpoint);
+
+// Benchmark mode
+void report_latencies(const char *name, double *samples, int count);
+void generate_bench_campus(int n_rooms, int n_users, int n_history);
+bool write_bench_rooms_text();
+int  run_benchmarks(int n_rooms, int n_users, int n_history);
+
+// Schedule bitmap
+bool slot_is_booked(const Classroom *room, int day, int hour);
+void set_slot_booked(Classroom *room, int day, int hour, bool booked);
+uint32_t free_window_starts(uint32_t day_bits, int hours);
+int  lowest_bit(uint32_t bits);
+int  count_bits(uint32_t bits);
+int  lowest_bit64(uint64_t bits);
+int  rooms_free_at(int day, int minute, uint64_t *out_set);
+int  rooms_free_for(int day, int start_hour, int hours, uint64_t *out_set);
+int  rooms_free_between(int day, int start, int end, uint64_t *out_set);
+bool room_set_contains(const uint64_t *set, int room_index);
 
 // Helper Functions
 
 void pause_and_clear() {
     printf("\n\n\t\t\t\t\tPress any key to continue...");
-    getch();
-#ifdef _WIN32
-    system("CLS");
-#else
-    system("clear");
-#endif
+    get_key();
+    clear_screen();
 }
 
 void hour_to_ampm(int hour24, char* output) {
@@ -118,21 +902,36 @@ void hour_to_ampm(int hour24, char* output) {
     }
 }
 
+// Whole hours only; see parse_time_input() for "9:30AM"
 bool parse_ampm_input(const char* input, int* hour24) {
-    int hour;
+    int minute;
+    if (!parse_time_input(input, &minute) || minute % 60 != 0) {
+        return false;
+    }
+    *hour24 = minute / 60;
+    return true;
+}
+
+// "9AM", "9 am", "9:30AM" or "9:30 PM" as minutes from midnight
+bool parse_time_input(const char *input, int *minute) {
+    int hour, minutes = 0, parsed = 0;
     char period[3] = {0};
-    int parsed = 0;
+    const char *p = input;
 
-    // Try formats: "9AM", "9am"
-    if (sscanf(input, "%d%2s%n", &hour, period, &parsed) == 2 && input[parsed] == '\0') {
-        // okay
+    if (sscanf(p, "%d%n", &hour, &parsed) != 1) {
+        return false;
     }
-    // Try formats: "9 AM", "9 am"
-    else if (sscanf(input, "%d %2s%n", &hour, period, &parsed) == 2 && input[parsed] == '\0') {
-        // okay
+    p += parsed;
+    if (*p == ':') {
+        if (!isdigit((unsigned char)p[1]) || !isdigit((unsigned char)p[2])) {
+            return false;
+        }
+        minutes = (p[1] - '0') * 10 + (p[2] - '0');
+        p += 3;
     }
-    else {
-        return false; // invalid format
+    while (*p == ' ') p++;
+    if (sscanf(p, "%2s%n", period, &parsed) != 1 || p[parsed] != '\0') {
+        return false;
     }
 
     // Normalize suffix to uppercase
@@ -144,22 +943,47 @@ bool parse_ampm_input(const char* input, int* hour24) {
     if (strcmp(period, "AM") != 0 && strcmp(period, "PM") != 0) {
         return false;
     }
-
-    // Validate hour range
-    if (hour < 1 || hour > 12) {
+    if (hour < 1 || hour > 12 || minutes > 59) {
         return false;
     }
 
-    // Convert to 24-hour format
-    if (strcmp(period, "AM") == 0) {
-        *hour24 = (hour == 12) ? 0 : hour;   // 12AM → 0
-    } else { // PM
-        *hour24 = (hour == 12) ? 12 : hour + 12;  // 12PM → 12
+    // Convert to 24-hour format: 12AM is 0, 12PM is 12
+    int hour24 = hour % 12 + (strcmp(period, "PM") == 0 ? 12 : 0);
+    *minute = hour24 * 60 + minutes;
+    return true;
+}
+
+// Booking length: "2" or "1.5" hours, or "90m"
+bool parse_duration(const char *input, int *minutes) {
+    char *end;
+    double value = strtod(input, &end);
+    if (end == input) {
+        return false;
+    }
+    if (*end == 'm' || *end == 'M') {
+        end++;
+    } else {
+        value *= 60;
+    }
+    while (isspace((unsigned char)*end)) end++;
+    if (*end != '\0' || !(value >= 1 && value <= MINUTES_PER_DAY)) {
+        return false;
     }
 
+    int whole = (int)(value + 0.5);
+    if (whole - value > 1e-6 || value - whole > 1e-6) {
+        return false; // not a whole number of minutes
+    }
+    *minutes = whole;
     return true;
 }
 
+// Start and end are on the --slot-minutes grid and within one day
+bool valid_booking_span(int start, int end) {
+    return start >= 0 && start < end && end <= MINUTES_PER_DAY &&
+           start % slot_minutes == 0 && end % slot_minutes == 0;
+}
+
 void to_lower_case(char *str) {
     for (int i = 0; str[i]; i++) {
         str[i] = (char)tolower((unsigned char)str[i]);
@@ -167,14 +991,13 @@ void to_lower_case(char *str) {
 }
 
 int str_casecmp(const char *a, const char *b) {
-    char ca[128], cb[128];
-    strncpy(ca, a, sizeof(ca)-1);
-    strncpy(cb, b, sizeof(cb)-1);
-    ca[sizeof(ca)-1] = '\0';
-    cb[sizeof(cb)-1] = '\0';
-    to_lower_case(ca);
-    to_lower_case(cb);
-    return strcmp(ca, cb);
+    const unsigned char *pa = (const unsigned char *)a;
+    const unsigned char *pb = (const unsigned char *)b;
+    while (*pa && tolower(*pa) == tolower(*pb)) {
+        pa++;
+        pb++;
+    }
+    return tolower(*pa) - tolower(*pb);
 }
 
 int validate_day(const char *dayStr) {
@@ -191,12 +1014,101 @@ int validate_day(const char *dayStr) {
     return -1;
 }
 
-bool validate_hour(int hour) {
-    bool valid = (hour >= 0 && hour <= 23);
-    if (!valid) {
-        fprintf(stderr, "System Alert: Invalid hour detected (%d)\n", hour);
+// Parses "Mon" or "Mon,Wed,Fri" into a mask with bit d set per day.
+// No strtok(): server threads parse day lists concurrently.
+bool parse_day_list(const char *text, int *day_mask) {
+    int mask = 0;
+    for (const char *p = text + strspn(text, ", "); *p; p += strspn(p, ", ")) {
+        char token[16];
+        size_t len = strcspn(p, ", ");
+        if (len >= sizeof(token)) return false;
+        memcpy(token, p, len);
+        token[len] = '\0';
+        p += len;
+
+        int day = validate_day(token);
+        if (day == -1) return false;
+        mask |= 1 << day;
+    }
+    if (mask == 0) return false;
+    *day_mask = mask;
+    return true;
+}
+
+void format_day_list(int day_mask, char *out, size_t size) {
+    size_t len = 0;
+    out[0] = '\0';
+    for (int d = 0; d < 7; d++) {
+        if (day_mask & (1 << d)) {
+            len += (size_t)snprintf(out + len, len < size ? size - len : 0, "%s%s",
+                                    len ? ", " : "", days[d]);
+        }
+    }
+}
+
+void minute_to_ampm(int minute, char *output) {
+    int hour24 = (minute / 60) % 24, minutes = minute % 60;
+    int hour = hour24 % 12 == 0 ? 12 : hour24 % 12;
+    const char *period = hour24 < 12 ? "AM" : "PM";
+    if (minutes) {
+        sprintf(output, "%d:%02d%s", hour, minutes, period);
+    } else {
+        sprintf(output, "%d%s", hour, period);
+    }
+}
+
+// "9AM" for one whole hour, otherwise "9AM-10:30AM"
+void format_minute_range(int start, int end, char *out, size_t size) {
+    char from[10], to[10];
+    minute_to_ampm(start, from);
+    if (start % 60 == 0 && end - start == 60) {
+        snprintf(out, size, "%s", from);
+        return;
+    }
+    minute_to_ampm(end, to);
+    snprintf(out, size, "%s-%s", from, to);
+}
+
+// Minutes from midnight covered by a log record's hour fields
+void record_minutes(int hour, int hours, int flags, int *start, int *end) {
+    int unit = (flags & LOG_FLAG_QUARTERS) ? 15 : 60;
+    *start = hour * unit;
+    *end = (hour + hours) * unit;
+}
+
+// "9AM" for one hour, "9AM-12PM" for a range
+void format_hour_range(int hour, int hours, char *out, size_t size) {
+    char start[10], end[10];
+    hour_to_ampm(hour, start);
+    if (hours <= 1) {
+        snprintf(out, size, "%s", start);
+        return;
+    }
+    hour_to_ampm((hour + hours) % 24, end);
+    snprintf(out, size, "%s-%s", start, end);
+}
+
+// "2026-10-20 (Tue)" for a dated booking, otherwise the weekday list
+void format_booking_days(int week, int day_mask, char *out, size_t size) {
+    if (week <= 0 || (day_mask & 0x7F) == 0) {
+        format_day_list(day_mask, out, size);
+        return;
     }
-    return valid;
+    int day = lowest_bit((uint32_t)day_mask);
+    char date[16];
+    format_date(week, day, date, sizeof(date));
+    snprintf(out, size, "%s (%s)", date, days[day]);
+}
+
+// "Mon at 9AM", "Mon, Wed at 9AM-12PM" for range/recurring records, or
+// "2026-10-20 (Tue) at 9AM" for dated ones
+void format_record_when(const BookingRecord *rec, char *out, size_t size) {
+    char day_list[40], time_range[24];
+    int start, end;
+    format_booking_days(rec->week, rec->day_mask, day_list, sizeof(day_list));
+    record_minutes(rec->hour, rec->hours, rec->flags, &start, &end);
+    format_minute_range(start, end, time_range, sizeof(time_range));
+    snprintf(out, size, "%s at %s", day_list, time_range);
 }
 
 bool validate_room_type(const char *type) {
@@ -207,11 +1119,9 @@ bool validate_room_type(const char *type) {
     return strcmp(lower_type, "lab") == 0 || strcmp(lower_type, "general") == 0;
 }
 
+// Any positive id; the hundreds give the floor, so 1204 is on floor 12
 bool validate_room_id(int id) {
-    if (id < 101 || id > 999) return false;
-    int floor = id / 100;
-    int room = id % 100;
-    return (floor >= 1 && floor <= 9) && (room >= 1 && room <= 99);
+    return id > 0;
 }
 
 void set_text_color(int color) {
@@ -219,16 +1129,74 @@ void set_text_color(int color) {
     HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
     SetConsoleTextAttribute(hConsole, (WORD)color);
 #else
-    (void)color;
+    if (stdout_is_terminal()) printf("\033[%dm", ansi_color_code(color));
+#endif
+}
+
+// Keyboard Input
+// Single keys and passwords are read unbuffered and without echo: _getch()
+// on Windows, termios non-canonical mode elsewhere. The terminal is switched
+// once per prompt, not per key. When stdin is not a terminal keys simply
+// come from the stdio stream.
+
+bool enter_raw_input() {
+#ifdef _WIN32
+    return true;
+#else
+    if (raw_input) return true;
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &saved_termios) != 0) return false;
+
+    struct termios raw = saved_termios;
+    raw.c_lflag &= ~(tcflag_t)(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &raw) != 0) return false;
+    raw_input = true;
+    return true;
+#endif
+}
+
+void leave_raw_input() {
+#ifndef _WIN32
+    if (!raw_input) return;
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved_termios);
+    raw_input = false;
+#endif
+}
+
+// Next key, EOF when input ends. In raw mode the byte is read straight from
+// the terminal, like _getch(), so it never waits for Enter.
+int read_key() {
+#ifdef _WIN32
+    return _getch();
+#else
+    if (!raw_input) return getchar();
+    unsigned char ch;
+    ssize_t n;
+    do {
+        n = read(STDIN_FILENO, &ch, 1);
+    } while (n < 0 && errno == EINTR);
+    return n == 1 ? ch : EOF;
 #endif
 }
 
+// One keypress for "Press any key" prompts
+int get_key() {
+    fflush(stdout);
+    bool raw = enter_raw_input();
+    int ch = read_key();
+    if (raw) leave_raw_input();
+    return ch;
+}
+
 void get_password(char *password, size_t maxlen) {
     size_t i = 0;
     int ch;
+    fflush(stdout);
+    bool raw = enter_raw_input();
     while (1) {
-        ch = getch();
-        if (ch == 13 || ch == '\n') {
+        ch = read_key();
+        if (ch == 13 || ch == '\n' || ch == EOF) {
             password[i] = '\0';
             printf("\n");
             break;
@@ -238,1000 +1206,6679 @@ void get_password(char *password, size_t maxlen) {
                 printf("\b \b");
             }
         } else if (ch == 0 || ch == 224) {
-            (void)getch();
+            (void)read_key(); // Windows function/arrow key prefix
         } else if (i + 1 < maxlen && ch >= 32 && ch <= 126) {
             password[i++] = (char)ch;
             printf("*");
         }
+        fflush(stdout);
     }
+    if (raw) leave_raw_input();
 }
 
-// Text File Operations
+// One whole line without the newline; an over-long line is cut to fit and
+// the rest discarded. False at end of input.
+bool read_line(char *buf, size_t size) {
+    fflush(stdout);
+    if (!fgets(buf, (int)size, stdin)) return false;
 
-bool file_exists(const char *path) {
-    FILE *fp = fopen(path, "r");
-    if (fp) {
-        fclose(fp);
-        return true;
+    size_t len = strlen(buf);
+    if (len > 0 && buf[len - 1] == '\n') {
+        buf[--len] = '\0';
+    } else {
+        int ch;
+        while ((ch = getchar()) != '\n' && ch != EOF);
     }
-    return false;
+    if (len > 0 && buf[len - 1] == '\r') buf[--len] = '\0';
+    return true;
 }
 
-bool save_users() {
-    FILE *fp = fopen(USERS_FILE, "w");
-    if (!fp) return false;
+// Menu number from one input line; -1 if it is not a number, -2 at end of input
+int read_menu_choice() {
+    char line[32];
+    if (!read_line(line, sizeof(line))) return -2;
 
-    fprintf(fp, "%d\n", user_count);
+    char *end;
+    long choice = strtol(line, &end, 10);
+    while (isspace((unsigned char)*end)) end++;
+    if (end == line || *end != '\0' || choice < 0 || choice > 99) return -1;
+    return (int)choice;
+}
 
-    for (int i = 0; i < user_count; i++) {
-        fprintf(fp, "%s %s %d\n",
-               users[i].username,
-               users[i].password,
-               users[i].is_admin ? 1 : 0);
-    }
+// Screen Output
+// Listings are rendered into one Screen and written with a single call
+// instead of a printf and a console call per line. Colors take the console
+// attribute numbers used by set_text_color() and are only emitted when text
+// follows in a different color, so the reset-then-color pairs between lines
+// collapse into at most one change.
 
-    fclose(fp);
-    return true;
+bool is_terminal(FILE *fp) {
+#ifdef _WIN32
+    return _isatty(_fileno(fp)) != 0;
+#else
+    return isatty(fileno(fp)) != 0;
+#endif
 }
 
-bool load_users() {
-    FILE *fp = fopen(USERS_FILE, "r");
-    if (!fp) return false;
+bool stdout_is_terminal() {
+    if (stdout_terminal == -1) stdout_terminal = is_terminal(stdout);
+    return stdout_terminal == 1;
+}
 
-    if (fscanf(fp, "%d", &user_count) != 1) {
-        fclose(fp);
-        return false;
+// Visible rows of the terminal on stdout, SCREEN_DEFAULT_ROWS if unknown
+int terminal_rows() {
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+        return info.srWindow.Bottom - info.srWindow.Top + 1;
     }
-
-    for (int i = 0; i < user_count; i++) {
-        int is_admin;
-        if (fscanf(fp, "%49s %49s %d",
-                  users[i].username,
-                  users[i].password,
-                  &is_admin) != 3) {
-            fclose(fp);
-            return false;
-        }
-        users[i].is_admin = (is_admin == 1);
+#else
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0) {
+        return size.ws_row;
     }
-
-    fclose(fp);
-    return true;
+#endif
+    return SCREEN_DEFAULT_ROWS;
 }
 
-bool save_rooms() {
-    FILE *fp = fopen(ROOMS_FILE, "w");
-    if (!fp) return false;
-
-    fprintf(fp, "%d\n", room_count);
+// Clears the terminal in-process: console API on Windows, escape sequences
+// elsewhere. Piped or redirected output is left alone.
+void clear_screen() {
+    if (!stdout_is_terminal()) return;
+#ifdef _WIN32
+    HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (!GetConsoleScreenBufferInfo(handle, &info)) return;
+
+    DWORD cells = (DWORD)info.dwSize.X * (DWORD)info.dwSize.Y, written;
+    COORD home = {0, 0};
+    fflush(stdout);
+    FillConsoleOutputCharacterA(handle, ' ', cells, home, &written);
+    FillConsoleOutputAttribute(handle, info.wAttributes, cells, home, &written);
+    SetConsoleCursorPosition(handle, home);
+#else
+    // Home, clear the screen, then the scrollback
+    fputs("\033[H\033[2J\033[3J", stdout);
+    fflush(stdout);
+#endif
+}
 
-    for (int i = 0; i < room_count; i++) {
-        fprintf(fp, "%d %s %s\n",
-               rooms[i].id,
-               rooms[i].department,
-               rooms[i].type);
+// SGR parameter for a console attribute: blue=1 green=2 red=4 intensity=8
+// there, red=1 green=2 blue=4 in ANSI. 7 (the default) maps to a reset.
+int ansi_color_code(int color) {
+    int fg = color & 0x0F;
+    if (fg == 7) return 0;
+    int ansi = ((fg & 4) ? 1 : 0) | (fg & 2) | ((fg & 1) ? 4 : 0);
+    return ((fg & 8) ? 90 : 30) + ansi;
+}
 
-        for (int d = 0; d < 7; d++) {
-            for (int h = 0; h < 24; h++) {
-                fprintf(fp, "%d ", rooms[i].schedule[d][h] ? 1 : 0);
-            }
-            fprintf(fp, "\n");
-        }
+// Files and pipes get plain text; Windows consoles without ANSI support
+// fall back to attribute runs
+void screen_open(Screen *screen, FILE *out) {
+    memset(screen, 0, sizeof(*screen));
+    screen->color = 7;
+    screen->emitted = 7;
+    if (!is_terminal(out)) return;
+#ifdef _WIN32
+    HANDLE handle = (HANDLE)_get_osfhandle(_fileno(out));
+    DWORD mode;
+    if (GetConsoleMode(handle, &mode) &&
+        SetConsoleMode(handle, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING)) {
+        screen->ansi = true;
+    } else {
+        screen->console = true;
     }
-
-    fclose(fp);
-    return true;
+#else
+    screen->ansi = true;
+#endif
 }
 
-bool load_rooms() {
-    FILE *fp = fopen(ROOMS_FILE, "r");
-    if (!fp) return false;
+void screen_close(Screen *screen) {
+    free(screen->text);
+    free(screen->runs);
+    memset(screen, 0, sizeof(*screen));
+}
 
-    if (fscanf(fp, "%d", &room_count) != 1) {
-        fclose(fp);
-        return false;
-    }
+// Room for `extra` more bytes plus the terminator
+bool screen_reserve(Screen *screen, size_t extra) {
+    if (screen->failed) return false;
+    size_t needed = screen->length + extra + 1;
+    if (needed <= screen->capacity) return true;
 
-    for (int i = 0; i < room_count; i++) {
-        if (fscanf(fp, "%d %19s %9s",
-                  &rooms[i].id,
-                  rooms[i].department,
-                  rooms[i].type) != 3) {
-            fclose(fp);
-            return false;
-        }
+    size_t capacity = screen->capacity ? screen->capacity : SCREEN_MIN_CAPACITY;
+    while (capacity < needed) capacity *= 2;
 
-        for (int d = 0; d < 7; d++) {
-            for (int h = 0; h < 24; h++) {
-                int booked;
-                if (fscanf(fp, "%d", &booked) != 1) {
-                    fclose(fp);
-                    return false;
-                }
-                rooms[i].schedule[d][h] = (booked == 1);
-            }
-        }
+    char *text = realloc(screen->text, capacity);
+    if (!text) {
+        screen->failed = true;
+        return false;
     }
-
-    fclose(fp);
+    screen->text = text;
+    screen->capacity = capacity;
     return true;
 }
 
-bool append_booking_record_with_action(int room_id, int day, int hour, const char *username, char action) {
-    FILE *fp = fopen(BOOKINGS_FILE, "a");
-    if (!fp) return false;
+// Brings the text up to the requested color before more text is added.
+// Every change is also recorded as a run so paging knows the color in
+// effect at a page break.
+void screen_sync_color(Screen *screen) {
+    if (screen->color == screen->emitted || !(screen->ansi || screen->console)) return;
 
-    fprintf(fp, "%d %d %d %c %s\n",
-           room_id, day, hour, action, username);
+    if (!grow_array((void **)&screen->runs, &screen->run_capacity,
+                    screen->run_count + 1, sizeof(ColorRun)) ||
+        !screen_reserve(screen, 8)) {
+        screen->failed = true;
+        return;
+    }
+    screen->runs[screen->run_count].offset = screen->length;
+    screen->runs[screen->run_count].color = screen->color;
+    screen->run_count++;
 
-    fclose(fp);
-    return true;
+    if (screen->ansi) {
+        screen->length += (size_t)snprintf(screen->text + screen->length, 8, "\033[%dm",
+                                           ansi_color_code(screen->color));
+    }
+    screen->emitted = screen->color;
 }
 
-bool get_last_slot_action(int room_id, int day, int hour, char *out_username, char *out_action, bool *found) {
-    *found = false;
-    FILE *fp = fopen(BOOKINGS_FILE, "r");
-    if (!fp) return true;
+void screen_printf(Screen *screen, const char *format, ...) {
+    screen_sync_color(screen);
+    if (screen->failed) return;
+
+    size_t room = screen->capacity - screen->length;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(screen->text ? screen->text + screen->length : NULL,
+                      screen->text ? room : 0, format, args);
+    va_end(args);
+    if (n < 0) return;
+
+    if (!screen->text || (size_t)n >= room) {
+        if (!screen_reserve(screen, (size_t)n)) return;
+        va_start(args, format);
+        vsnprintf(screen->text + screen->length, (size_t)n + 1, format, args);
+        va_end(args);
+    }
+    screen->length += (size_t)n;
+}
 
-    char line[256];
-    BookingRecord last_match;
+void screen_color(Screen *screen, int color) {
+    screen->color = color;
+}
 
-    while (fgets(line, sizeof(line), fp)) {
-        BookingRecord rec;
-        if (sscanf(line, "%d %d %d %c %49s",
-                  &rec.room_id,
-                  &rec.day,
-                  &rec.hour,
-                  &rec.action,
-                  rec.username) == 5) {
-            if (rec.room_id == room_id && rec.day == day && rec.hour == hour) {
-                last_match = rec;
-                *found = true;
-            }
+// Writes text[from, to). *run is the first color run not yet passed and
+// only moves forward. On a console the run in effect at `from` and every
+// run starting inside the range are applied as they are reached.
+void screen_write(Screen *screen, FILE *out, size_t from, size_t to, int *run) {
+    bool first = true;
+    for (;;) {
+        bool changed = first && *run > 0;
+        while (*run < screen->run_count && screen->runs[*run].offset <= from) {
+            (*run)++;
+            changed = true;
         }
-    }
-    fclose(fp);
+        first = false;
+#ifdef _WIN32
+        if (changed && screen->console) {
+            fflush(out);
+            SetConsoleTextAttribute((HANDLE)_get_osfhandle(_fileno(out)),
+                                    (WORD)screen->runs[*run - 1].color);
+        }
+#else
+        (void)changed;
+#endif
+        if (from >= to) break;
 
-    if (*found) {
-        if (out_username) strcpy(out_username, last_match.username);
-        if (out_action) *out_action = last_match.action;
+        size_t end = to;
+        if (screen->console && *run < screen->run_count && screen->runs[*run].offset < end) {
+            end = screen->runs[*run].offset;
+        }
+        fwrite(screen->text + from, 1, end - from, out);
+        if (!screen->console) {
+            // Escapes travel inside the text; just keep *run in step
+            while (*run < screen->run_count && screen->runs[*run].offset < end) (*run)++;
+        }
+        from = end;
     }
-    return true;
 }
 
-// Core Functions
-
-void initialize_sample_data() {
-    memset(users, 0, sizeof(users));
-    memset(rooms, 0, sizeof(rooms));
-
-    strcpy(users[0].username, "admin");
-    strcpy(users[0].password, "admin123");
-    users[0].is_admin = true;
+// Writes the screen out and empties it. When `paged` and both stdin and
+// `out` are terminals, stops after every page: Enter shows the next page,
+// Q skips the rest.
+void screen_flush(Screen *screen, FILE *out, bool paged) {
+    screen_color(screen, 7);
+    screen_sync_color(screen);
+
+    int page_lines = paged && is_terminal(out) && is_terminal(stdin) ? terminal_rows() - 1 : 0;
+    int run = 0;
+    size_t from = 0;
+    bool stopped = false;
+
+    while (page_lines > 0 && from < screen->length) {
+        size_t end = from;
+        int lines = 0;
+        while (end < screen->length && lines < page_lines) {
+            if (screen->text[end++] == '\n') lines++;
+        }
+        if (end >= screen->length) break;
 
-    strcpy(users[1].username, "faculty");
-    strcpy(users[1].password, "faculty123");
-    users[1].is_admin = false;
-    user_count = 2;
+        screen_write(screen, out, from, end, &run);
+        from = end;
 
-    int idx = 0;
-    for (int i = 101; i <= 123 && idx < MAX_ROOMS; i++) {
-        rooms[idx].id = i;
-        strcpy(rooms[idx].department, "CSE");
-        strcpy(rooms[idx].type, "lab");
-        memset(rooms[idx].schedule, 0, sizeof(rooms[idx].schedule));
-        idx++;
+        // The prompt is always in the default color
+        int active = run > 0 ? screen->runs[run - 1].color : 7;
+        if (screen->ansi && active != 7) fputs("\033[0m", out);
+#ifdef _WIN32
+        if (screen->console && active != 7) set_text_color(7);
+#endif
+        fprintf(out, "\t\t\t\t\t-- More (%d%%): Enter for the next page, Q to stop -- ",
+                (int)(from * 100 / screen->length));
+        fflush(out);
+
+        char answer[8];
+        bool more = read_line(answer, sizeof(answer));
+        if (screen->ansi) fputs("\033[1A\033[2K", out); // drop the prompt line
+        if (!more || toupper((unsigned char)answer[0]) == 'Q') {
+            stopped = true;
+            break;
+        }
+        if (screen->ansi && active != 7) fprintf(out, "\033[%dm", ansi_color_code(active));
+        // a console gets the active run back from screen_write
     }
 
-    for (int i = 201; i <= 223 && idx < MAX_ROOMS; i++) {
-        rooms[idx].id = i;
-        strcpy(rooms[idx].department, "EEE");
-        strcpy(rooms[idx].type, "general");
-        memset(rooms[idx].schedule, 0, sizeof(rooms[idx].schedule));
-        idx++;
+    if (stopped) {
+        // Skip the rest but still apply the final reset
+        screen_write(screen, out, screen->length, screen->length, &run);
+        if (screen->ansi) fputs("\033[0m", out);
+    } else {
+        screen_write(screen, out, from, screen->length, &run);
     }
+    if (screen->failed) fprintf(out, "\n\t\t\t\t\t(Listing truncated: out of memory)\n");
+    fflush(out);
+
+    screen->length = 0;
+    screen->run_count = 0;
+    screen->color = 7;
+    screen->emitted = 7;
+    screen->failed = false;
+}
 
-    for (int i = 301; i <= 323 && idx < MAX_ROOMS; i++) {
-        rooms[idx].id = i;
-        strcpy(rooms[idx].department, "CSE");
-        strcpy(rooms[idx].type, "lab");
-        memset(rooms[idx].schedule, 0, sizeof(rooms[idx].schedule));
-        idx++;
-    }
-    room_count = idx;
+// Table Storage
+// rooms/users and their per-room side tables are contiguous arrays that
+// grow geometrically, so iteration stays a flat loop and appends are
+// amortised O(1). Loaders presize them from the count in the file header.
+
+// Next capacity of a table of `capacity` (0 before the first allocation)
+// holding `needed` items: doubled until it fits, capped at INT_MAX. 0 when
+// `needed` items of `item_size` bytes cannot be addressed.
+size_t grown_capacity(int capacity, int needed, size_t item_size) {
+    if (needed < 0 || (size_t)needed > SIZE_MAX / item_size) return 0;
+    size_t limit = SIZE_MAX / item_size < (size_t)INT_MAX ? SIZE_MAX / item_size : (size_t)INT_MAX;
+    size_t grown = capacity > 0 ? (size_t)capacity : TABLE_MIN_CAPACITY;
+    while (grown < (size_t)needed) grown = grown > limit / 2 ? limit : grown * 2;
+    return grown;
+}
 
-    FILE *fp = fopen(BOOKINGS_FILE, "a");
-    if (fp) fclose(fp);
+bool reserve_rooms(int needed) {
+    if (needed <= room_capacity) return true;
+
+    // Sized for the largest per-room item; the others are smaller
+    size_t largest = sizeof(*rooms) > sizeof(*slot_history) ? sizeof(*rooms) : sizeof(*slot_history);
+    size_t grown = grown_capacity(room_capacity, needed, largest);
+    if (grown == 0) return false;
+    int new_capacity = (int)grown;
+
+    Classroom *new_rooms = realloc(rooms, (size_t)new_capacity * sizeof(*rooms));
+    if (!new_rooms) return false;
+    rooms = new_rooms;
+
+    SlotAction (*new_history)[7][24] = realloc(slot_history, (size_t)new_capacity * sizeof(*slot_history));
+    if (!new_history) return false;
+    slot_history = new_history;
+
+    uint8_t *new_dirty = realloc(room_dirty_days, (size_t)new_capacity * sizeof(*room_dirty_days));
+    if (!new_dirty) return false;
+    room_dirty_days = new_dirty;
+
+    int *new_calendar = realloc(room_calendar, (size_t)new_capacity * sizeof(*room_calendar));
+    if (!new_calendar) return false;
+    room_calendar = new_calendar;
+    for (int i = room_capacity; i < new_capacity; i++) room_calendar[i] = -1;
+
+    IntervalIndex *new_intervals = realloc(room_intervals, (size_t)new_capacity * sizeof(*room_intervals));
+    if (!new_intervals) return false;
+    room_intervals = new_intervals;
+    memset(room_intervals + room_capacity, 0,
+           (size_t)(new_capacity - room_capacity) * sizeof(*room_intervals));
+
+    size_t added = (size_t)(new_capacity - room_capacity);
+    memset(rooms + room_capacity, 0, added * sizeof(*rooms));
+    memset(slot_history + room_capacity, 0, added * sizeof(*slot_history));
+    memset(room_dirty_days + room_capacity, 0, added * sizeof(*room_dirty_days));
+    room_capacity = new_capacity;
+    return true;
 }
 
-void ensure_data_loaded_or_initialized() {
-    bool users_ok = file_exists(USERS_FILE) && load_users();
-    bool rooms_ok = file_exists(ROOMS_FILE) && load_rooms();
+bool reserve_users(int needed) {
+    if (needed <= user_capacity) return true;
 
-    if (!users_ok || !rooms_ok) {
-        printf("\nInitializing sample data...\n");
-        initialize_sample_data();
-        if (!save_users()) {
-            printf("Warning: Failed to save initial users!\n");
-        }
-        if (!save_rooms()) {
-            printf("Warning: Failed to save initial rooms!\n");
-        }
-    }
+    size_t largest = sizeof(*users) > sizeof(*user_bookings) ? sizeof(*users) : sizeof(*user_bookings);
+    size_t grown = grown_capacity(user_capacity, needed, largest);
+    if (grown == 0) return false;
+    int new_capacity = (int)grown;
 
-    if (!file_exists(BOOKINGS_FILE)) {
-        FILE *fp = fopen(BOOKINGS_FILE, "a");
-        if (fp) fclose(fp);
-    }
+    User *new_users = realloc(users, (size_t)new_capacity * sizeof(*users));
+    if (!new_users) return false;
+    users = new_users;
+
+    UserBookings *new_bookings = realloc(user_bookings, (size_t)new_capacity * sizeof(*user_bookings));
+    if (!new_bookings) return false;
+    user_bookings = new_bookings;
+
+    size_t added = (size_t)(new_capacity - user_capacity);
+    memset(users + user_capacity, 0, added * sizeof(*users));
+    memset(user_bookings + user_capacity, 0, added * sizeof(*user_bookings));
+    user_capacity = new_capacity;
+    return true;
 }
 
-void register_user() {
-    if (user_count >= MAX_USERS) {
-        printf("\t\t\t\t\tMaximum user capacity reached.\n");
-        pause_and_clear();
-        return;
-    }
+// Doubling growth for the small per-user lists
+bool grow_array(void **items, int *capacity, int needed, size_t item_size) {
+    if (needed <= *capacity) return true;
 
-    char uname[50], pass[50];
-    printf("\t\t\t\t\tEnter username: ");
-    scanf(" %49s", uname);
-    while (getchar() != '\n');
+    size_t new_capacity = grown_capacity(*capacity ? *capacity : 8, needed, item_size);
+    if (new_capacity == 0) return false;
 
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, uname) == 0) {
-            printf("\t\t\t\t\tUsername already exists.\n");
-            pause_and_clear();
-            return;
-        }
-    }
+    void *grown = realloc(*items, new_capacity * item_size);
+    if (!grown) return false;
+    *items = grown;
+    *capacity = (int)new_capacity;
+    return true;
+}
 
-    printf("\t\t\t\t\tEnter password: ");
-    get_password(pass, sizeof(pass));
+// Room sets are sized for the current table; the extra word keeps the
+// allocation non-empty when there are no rooms
+uint64_t *alloc_room_set() {
+    return calloc(ROOM_SET_WORDS(room_count) + 1, sizeof(uint64_t));
+}
 
-    strncpy(users[user_count].username, uname, sizeof(users[user_count].username)-1);
-    users[user_count].username[sizeof(users[user_count].username)-1] = '\0';
-    strncpy(users[user_count].password, pass, sizeof(users[user_count].password)-1);
-    users[user_count].password[sizeof(users[user_count].password)-1] = '\0';
-    users[user_count].is_admin = false;
-    user_count++;
+// Hash Indexes
+// Open addressing with linear probing over a power-of-two slot array.
+// Slots hold table index + 1 so zero means empty. Tables never shrink,
+// so there are no tombstones; the load factor is kept at or below 1/2.
 
-    if (!save_users()) {
-        printf("\t\t\t\t\tWarning: failed to save users to file!\n");
-    } else {
-        printf("\t\t\t\t\tRegistration successful and saved.\n");
+uint32_t hash_room_id(int room_id) {
+    return (uint32_t)room_id * 2654435761u; // Knuth multiplicative hash
+}
+
+uint32_t hash_username(const char *username) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)username; *p; p++) {
+        h = (h ^ *p) * 16777619u;
     }
-    pause_and_clear();
+    return h;
 }
 
-bool login() {
-    char username[50], password[50];
-    printf("\t\t\t\t\tUsername: ");
-    scanf(" %49s", username);
-    while (getchar() != '\n');
+// Sizes the slot array for `entries` keys and clears it
+bool hash_index_reset(HashIndex *index, int entries) {
+    int capacity = HASH_MIN_CAPACITY;
+    while (capacity < entries * 2) capacity *= 2;
 
-    printf("\t\t\t\t\tPassword: ");
-    get_password(password, sizeof(password));
+    if (capacity != index->capacity) {
+        int *slots = realloc(index->slots, (size_t)capacity * sizeof(int));
+        if (!slots) return false;
+        index->slots = slots;
+        index->capacity = capacity;
+    }
+    memset(index->slots, 0, (size_t)index->capacity * sizeof(int));
+    index->used = 0;
+    return true;
+}
 
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].username, username) == 0 &&
-            strcmp(users[i].password, password) == 0) {
-            current_user_index = i;
-            printf("\t\t\t\t\tLogin successful. Welcome %s!\n", username);
-            pause_and_clear();
-            return true;
-        }
+void insert_room_slot(int room_index) {
+    uint32_t mask = (uint32_t)room_id_index.capacity - 1;
+    uint32_t pos = hash_room_id(rooms[room_index].id) & mask;
+    while (room_id_index.slots[pos] != 0) {
+        if (rooms[room_id_index.slots[pos] - 1].id == rooms[room_index].id) return; // first one wins
+        pos = (pos + 1) & mask;
     }
+    room_id_index.slots[pos] = room_index + 1;
+    room_id_index.used++;
+}
 
-    printf("\t\t\t\t\tLogin failed. Invalid username or password.\n");
-    pause_and_clear();
-    return false;
+void insert_user_slot(int user_index) {
+    uint32_t mask = (uint32_t)username_index.capacity - 1;
+    uint32_t pos = hash_username(users[user_index].username) & mask;
+    while (username_index.slots[pos] != 0) {
+        if (strcmp(users[username_index.slots[pos] - 1].username, users[user_index].username) == 0) return;
+        pos = (pos + 1) & mask;
+    }
+    username_index.slots[pos] = user_index + 1;
+    username_index.used++;
 }
 
-void get_search_input(char *dept, int *day, int *hour, char *type) {
-    char dayInput[10];
-    char timeInput[20];
+bool rebuild_room_index() {
+    if (!hash_index_reset(&room_id_index, room_count)) return false;
+    for (int i = 0; i < room_count; i++) insert_room_slot(i);
+    return true;
+}
 
-    while (1) {
-        printf("\t\t\t\t\tDepartment (CSE/EEE/...): ");
-        if (scanf(" %19s", dept) != 1) {
-            while (getchar() != '\n');
-            continue;
-        }
+bool rebuild_user_index() {
+    if (!hash_index_reset(&username_index, user_count)) return false;
+    for (int i = 0; i < user_count; i++) insert_user_slot(i);
+    return true;
+}
 
-        printf("\t\t\t\t\tDay (Sun, Mon, Tue, Wed, Thu, Fri, Sat): ");
-        if (scanf(" %9s", dayInput) != 1) {
-            while (getchar() != '\n');
-            continue;
-        }
+// Call after appending rooms[room_index]
+bool index_room(int room_index) {
+    if ((room_id_index.used + 1) * 2 > room_id_index.capacity) return rebuild_room_index();
+    insert_room_slot(room_index);
+    return true;
+}
 
-        *day = validate_day(dayInput);
-        if (*day == -1) {
-            printf("\t\t\t\t\tInvalid day. Please try again.\n");
-            continue;
-        }
+// Call after appending users[user_index]
+bool index_user(int user_index) {
+    if ((username_index.used + 1) * 2 > username_index.capacity) return rebuild_user_index();
+    insert_user_slot(user_index);
+    return true;
+}
 
-        while (getchar() != '\n'); // clear input buffer
+// Department/Type Index
+// Department and type strings are interned once, lowercased, into small
+// id tables; rooms are then bucketed by (department id, type id) so a
+// search walks only its own bucket and compares integers.
 
-        printf("\t\t\t\t\tTime (e.g., 9AM, 2PM, 12AM): ");
-        if (!fgets(timeInput, sizeof(timeInput), stdin)) {
-            continue;
-        }
+void normalize_name(const char *src, char *dst, size_t size) {
+    size_t i = 0;
+    for (; src[i] && i + 1 < size; i++) {
+        dst[i] = (char)tolower((unsigned char)src[i]);
+    }
+    dst[i] = '\0';
+}
 
-        timeInput[strcspn(timeInput, "\n")] = '\0'; // remove newline
+// Returns the id of an already interned name, -1 if it was never seen
+int lookup_name(const NameTable *table, const char *name) {
+    char key[NAME_KEY_LEN];
+    normalize_name(name, key, sizeof(key));
+    for (int i = 0; i < table->count; i++) {
+        if (strcmp(table->names[i], key) == 0) return i;
+    }
+    return -1;
+}
 
-        if (!parse_ampm_input(timeInput, hour)) {
-            printf("\t\t\t\t\tInvalid time format. Please enter like '9AM' or '2PM'.\n");
-            continue;
-        }
+int intern_name(NameTable *table, const char *name) {
+    int id = lookup_name(table, name);
+    if (id != -1) return id;
 
-        printf("\t\t\t\t\tRoom Type (Lab/General): ");
-        if (scanf(" %9s", type) != 1) {
-            while (getchar() != '\n');
-            continue;
+    if (table->count == table->capacity) {
+        int new_capacity = table->capacity ? table->capacity * 2 : 16;
+        char (*names)[NAME_KEY_LEN] = realloc(table->names, (size_t)new_capacity * sizeof(*names));
+        if (!names) return -1;
+        table->names = names;
+        table->capacity = new_capacity;
+    }
+    normalize_name(name, table->names[table->count], NAME_KEY_LEN);
+    return table->count++;
+}
+
+RoomGroup *find_room_group(int dept_id, int type_id) {
+    for (int g = 0; g < room_group_count; g++) {
+        if (room_groups[g].dept_id == dept_id && room_groups[g].type_id == type_id) {
+            return &room_groups[g];
         }
+    }
+    return NULL;
+}
 
-        to_lower_case(type);
-        if (!validate_room_type(type)) {
-            printf("\t\t\t\t\tInvalid room type. Please enter 'Lab' or 'General'.\n");
-            continue;
+// Call after appending rooms[room_index]
+bool group_room(int room_index) {
+    Classroom *room = &rooms[room_index];
+    room->dept_id = intern_name(&department_names, room->department);
+    room->type_id = intern_name(&room_type_names, room->type);
+    if (room->dept_id == -1 || room->type_id == -1) return false;
+
+    RoomGroup *group = find_room_group(room->dept_id, room->type_id);
+    if (!group) {
+        if (room_group_count == room_group_capacity) {
+            int new_capacity = room_group_capacity ? room_group_capacity * 2 : 16;
+            RoomGroup *groups = realloc(room_groups, (size_t)new_capacity * sizeof(*groups));
+            if (!groups) return false;
+            room_groups = groups;
+            room_group_capacity = new_capacity;
         }
+        group = &room_groups[room_group_count++];
+        memset(group, 0, sizeof(*group));
+        group->dept_id = room->dept_id;
+        group->type_id = room->type_id;
+    }
 
-        break; // all inputs valid
+    if (group->count == group->capacity) {
+        int new_capacity = group->capacity ? group->capacity * 2 : 16;
+        int *members = realloc(group->members, (size_t)new_capacity * sizeof(int));
+        if (!members) return false;
+        group->members = members;
+        group->capacity = new_capacity;
     }
+    group->members[group->count++] = room_index;
+    return true;
 }
 
+bool rebuild_room_groups() {
+    for (int g = 0; g < room_group_count; g++) {
+        free(room_groups[g].members);
+    }
+    room_group_count = 0;
+    department_names.count = 0;
+    room_type_names.count = 0;
 
-void search_classrooms() {
-    char dept[20], type[10];
-    int day, hour;
-
-    get_search_input(dept, &day, &hour, type);
+    for (int i = 0; i < room_count; i++) {
+        if (!group_room(i)) return false;
+    }
+    return true;
+}
 
-    char time_display[10];
-    hour_to_ampm(hour, time_display);
+// Schedule Bitmap
+// Each day is one word with bit h standing for hour h, so whole-day and
+// whole-campus questions become a handful of shifts and ANDs.
 
-    printf("\n\t\t\t\t\tAvailable rooms in %s department (%s):\n", dept, type);
-    printf("\t\t\t\t\tDay: %s, Time: %s\n", days[day], time_display);
-    printf("\t\t\t\t\t--------------------------------\n");
+bool slot_is_booked(const Classroom *room, int day, int hour) {
+#ifdef SLOTMAP_ATOMICS
+    return (__atomic_load_n(&room->schedule[day], __ATOMIC_RELAXED) >> hour) & 1u;
+#else
+    return (room->schedule[day] >> hour) & 1u;
+#endif
+}
 
-    bool found = false;
-    for (int i = 0; i < room_count; i++) {
-        if (str_casecmp(rooms[i].department, dept) == 0 &&
-            str_casecmp(rooms[i].type, type) == 0) {
-            int floor = rooms[i].id / 100;
-            set_text_color(6);
-            printf("\t\t\t\t\tRoom ID: %d (Floor %d) -> ", rooms[i].id, floor);
-
-            if (rooms[i].schedule[day][hour]) {
-                set_text_color(12);
-                printf("BOOKED\n");
-            } else {
-                set_text_color(10);
-                printf("AVAILABLE\n");
-            }
-            set_text_color(7);
-            found = true;
-        }
+void set_slot_booked(Classroom *room, int day, int hour, bool booked) {
+#ifdef SLOTMAP_ATOMICS
+    if (booked) {
+        __atomic_fetch_or(&room->schedule[day], 1u << hour, __ATOMIC_RELEASE);
+    } else {
+        __atomic_fetch_and(&room->schedule[day], ~(1u << hour), __ATOMIC_RELEASE);
     }
-
-    if (!found) {
-        set_text_color(4);
-        printf("\t\t\t\t\tNo rooms found matching criteria.\n");
+#else
+    if (booked) {
+        room->schedule[day] |= 1u << hour;
+    } else {
+        room->schedule[day] &= ~(1u << hour);
     }
-    pause_and_clear();
+#endif
 }
 
-int find_room_by_id(int room_id) {
-    for (int i = 0; i < room_count; i++) {
-        if (rooms[i].id == room_id)
-            return i;
+// Bit h of the result is set when hours h .. h+hours-1 are all free
+uint32_t free_window_starts(uint32_t day_bits, int hours) {
+    if (hours < 1 || hours > 24) return 0;
+
+    uint32_t starts = ~day_bits & DAY_MASK;
+    // Doubling: after each step bit h covers `span` free hours, so a
+    // window of any length takes at most five shift-ANDs. Bits past 11PM
+    // are zero, so windows running over midnight drop out.
+    int span = 1;
+    while (span * 2 <= hours) {
+        starts &= starts >> span;
+        span *= 2;
     }
-    return -1;
+    if (span < hours) starts &= starts >> (hours - span);
+    return starts;
 }
 
-int day_name_to_index(const char *day_name) {
-    for (int i = 0; i < 7; i++) {
-        if (strcasecmp(day_name, days[i]) == 0)
-            return i;
-    }
-    return -1;
+int count_bits(uint32_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcount(bits);
+#else
+    int n = 0;
+    for (; bits; bits &= bits - 1) n++;
+    return n;
+#endif
 }
 
-void book_slot() {
-    if (current_user_index == -1) {
-        printf("\t\t\t\t\tYou must be logged in to book a slot.\n");
-        pause_and_clear();
-        return;
+// Index of the lowest set bit; bits must be non-zero
+int lowest_bit(uint32_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(bits);
+#else
+    int n = 0;
+    while (!(bits & 1u)) {
+        bits >>= 1;
+        n++;
     }
+    return n;
+#endif
+}
 
-    int room_id, hour;
-    char day_str[10];
-    char hour_input[20];
-    bool valid_input = false;
-
-    // Room ID input with validation
-    while (!valid_input) {
-        printf("\t\t\t\t\tEnter Room ID (e.g., 101, 202, 303): ");
-        if (scanf("%d", &room_id) != 1) {
-            while (getchar() != '\n');
-            printf("\t\t\t\t\tInvalid input. Please enter a number.\n");
-            continue;
-        }
+int lowest_bit64(uint64_t bits) {
+    uint32_t low = (uint32_t)bits;
+    return low ? lowest_bit(low) : 32 + lowest_bit((uint32_t)(bits >> 32));
+}
 
-        if (!validate_room_id(room_id)) {
-            printf("\t\t\t\t\tInvalid Room ID. Must be 3 digits (e.g., 101).\n");
-            continue;
-        }
+bool room_set_contains(const uint64_t *set, int room_index) {
+    return (set[room_index / 64] >> (room_index % 64)) & 1u;
+}
 
-        if (find_room_by_id(room_id) == -1) {
-            printf("\t\t\t\t\tRoom ID not found. Please try again.\n");
-            continue;
-        }
+// Fills out_set (see alloc_room_set) with one bit per room that has no
+// weekly booking at `minute` of `day`; returns how many are free
+int rooms_free_at(int day, int minute, uint64_t *out_set) {
+    return rooms_free_between(day, minute, minute + 1, out_set);
+}
 
-        valid_input = true;
+int rooms_free_for(int day, int start_hour, int hours, uint64_t *out_set) {
+    if (start_hour < 0 || hours < 1 || start_hour + hours > 24) {
+        memset(out_set, 0, ROOM_SET_WORDS(room_count) * sizeof(uint64_t));
+        return 0;
     }
+    return rooms_free_between(day, start_hour * 60, (start_hour + hours) * 60, out_set);
+}
 
-    int room_index = find_room_by_id(room_id);
-    valid_input = false;
+// [start, end) are minutes of `day`. Dated weeks are not looked at.
+int rooms_free_between(int day, int start, int end, uint64_t *out_set) {
+    memset(out_set, 0, ROOM_SET_WORDS(room_count) * sizeof(uint64_t));
+    if (day < 0 || day > 6 || start < 0 || end <= start || end > MINUTES_PER_DAY) {
+        return 0;
+    }
 
-    // Day input with validation
-    while (!valid_input) {
-        printf("\t\t\t\t\tEnter Day (Sun, Mon, Tue, Wed, Thu, Fri, Sat): ");
-        if (scanf("%9s", day_str) != 1) {
-            while (getchar() != '\n');
-            printf("\t\t\t\t\tInvalid input.\n");
-            continue;
+    uint32_t window = hours_touched(start, end);
+    int offset = day * MINUTES_PER_DAY;
+    int free_count = 0;
+
+    // Branch-free inner loop: each room contributes one bit to its word
+    for (int base = 0; base < room_count; base += 64) {
+        int end_room = (room_count - base < 64) ? room_count - base : 64;
+        uint64_t word = 0;
+        for (int j = 0; j < end_room; j++) {
+#ifdef SLOTMAP_ATOMICS
+            uint32_t busy = __atomic_load_n(&rooms[base + j].schedule[day], __ATOMIC_RELAXED);
+#else
+            uint32_t busy = rooms[base + j].schedule[day];
+#endif
+            uint64_t is_free = (busy & window) == 0;
+            word |= is_free << j;
         }
-
-        int day = day_name_to_index(day_str);
-        if (day == -1) {
-            printf("\t\t\t\t\tInvalid day. Please enter one of: ");
-            for (int i = 0; i < 7; i++) {
-                printf("%s%s", days[i], (i < 6) ? ", " : "\n");
+        // Rooms still free with sub-hour bookings need a lookup; the room
+        // lock keeps server clients from growing the array meanwhile
+        for (uint64_t w = word; w; w &= w - 1) {
+            int j = lowest_bit64(w);
+            lock_room(base + j);
+            const IntervalIndex *index = &room_intervals[base + j];
+            if (index->count > 0 && interval_overlap(index, offset + start, offset + end) >= 0) {
+                word &= ~((uint64_t)1 << j);
             }
-            continue;
+            unlock_room(base + j);
         }
-
-        valid_input = true;
+        out_set[base / 64] = word;
+        for (uint64_t w = word; w; w &= w - 1) free_count++;
     }
+    return free_count;
+}
 
-    int day = day_name_to_index(day_str);
-    valid_input = false;
+// Password Hashing
+// users.txt stores "$pbkdf2-sha256$<iterations>$<salt>$<hash>" with a random
+// salt per user and hex fields, so the file stays whitespace separated.
+// PBKDF2-HMAC-SHA256 with a 32-byte output is a single block: every
+// iteration is one inner and one outer compression from precomputed HMAC
+// states. Plaintext entries from older files are accepted once and
+// rehashed on that login, as are hashes made at a different cost.
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+void sha256_init(Sha256 *ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->block_len = 0;
+    ctx->total_len = 0;
+}
 
-    // Clear input buffer before time input
-    while (getchar() != '\n');
+void sha256_compress(uint32_t state[8], const uint8_t block[64]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
 
-    // Time input with AM/PM validation
-    while (!valid_input) {
-        printf("\t\t\t\t\tEnter Time (e.g., 9 AM, 2 PM, 12 AM): ");
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) +
+                      ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) +
+                      ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha256_update(Sha256 *ctx, const void *data, size_t len) {
+    const uint8_t *bytes = data;
+    ctx->total_len += len;
+    while (len > 0) {
+        size_t take = 64 - ctx->block_len;
+        if (take > len) take = len;
+        memcpy(ctx->block + ctx->block_len, bytes, take);
+        ctx->block_len += take;
+        bytes += take;
+        len -= take;
+        if (ctx->block_len == 64) {
+            sha256_compress(ctx->state, ctx->block);
+            ctx->block_len = 0;
+        }
+    }
+}
+
+void sha256_final(Sha256 *ctx, uint8_t digest[32]) {
+    uint64_t bits = ctx->total_len * 8;
+    ctx->block[ctx->block_len++] = 0x80;
+    if (ctx->block_len > 56) {
+        memset(ctx->block + ctx->block_len, 0, 64 - ctx->block_len);
+        sha256_compress(ctx->state, ctx->block);
+        ctx->block_len = 0;
+    }
+    memset(ctx->block + ctx->block_len, 0, 56 - ctx->block_len);
+    for (int i = 0; i < 8; i++) ctx->block[56 + i] = (uint8_t)(bits >> (56 - 8 * i));
+    sha256_compress(ctx->state, ctx->block);
+
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (uint8_t)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+void pbkdf2_sha256(const char *password, const uint8_t *salt, size_t salt_len,
+                   int iterations, uint8_t out[32]) {
+    uint8_t key[64] = {0}, pad[64];
+    size_t key_len = strlen(password);
+    if (key_len > 64) {
+        Sha256 ctx;
+        sha256_init(&ctx);
+        sha256_update(&ctx, password, key_len);
+        sha256_final(&ctx, key);
+    } else {
+        memcpy(key, password, key_len);
+    }
+
+    // HMAC states after the padded key block, reused by every iteration
+    Sha256 inner, outer;
+    sha256_init(&inner);
+    for (int i = 0; i < 64; i++) pad[i] = key[i] ^ 0x36;
+    sha256_update(&inner, pad, 64);
+    sha256_init(&outer);
+    for (int i = 0; i < 64; i++) pad[i] = key[i] ^ 0x5c;
+    sha256_update(&outer, pad, 64);
+
+    // U1 = HMAC(salt || INT(1)), then Ui = HMAC(Ui-1), out = U1 ^ ... ^ Un
+    static const uint8_t block_index[4] = {0, 0, 0, 1};
+    uint8_t u[32];
+    Sha256 ctx = inner;
+    sha256_update(&ctx, salt, salt_len);
+    sha256_update(&ctx, block_index, 4);
+    sha256_final(&ctx, u);
+    ctx = outer;
+    sha256_update(&ctx, u, 32);
+    sha256_final(&ctx, u);
+    memcpy(out, u, 32);
+
+    for (int n = 1; n < iterations; n++) {
+        ctx = inner;
+        sha256_update(&ctx, u, 32);
+        sha256_final(&ctx, u);
+        ctx = outer;
+        sha256_update(&ctx, u, 32);
+        sha256_final(&ctx, u);
+        for (int i = 0; i < 32; i++) out[i] ^= u[i];
+    }
+}
+
+bool random_bytes(uint8_t *out, size_t len) {
+#ifdef _WIN32
+    for (size_t i = 0; i < len; i++) {
+        unsigned int value;
+        if (rand_s(&value) != 0) return false;
+        out[i] = (uint8_t)value;
+    }
+    return true;
+#else
+    FILE *fp = fopen("/dev/urandom", "rb");
+    if (!fp) return false;
+    bool ok = fread(out, 1, len, fp) == len;
+    fclose(fp);
+    return ok;
+#endif
+}
+
+// Time depends only on `len`, not on where the inputs differ
+bool constant_time_equal(const void *a, const void *b, size_t len) {
+    const volatile uint8_t *x = a, *y = b;
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++) diff |= x[i] ^ y[i];
+    return diff == 0;
+}
+
+bool hash_password(const char *password, int iterations, char *out, size_t size) {
+    uint8_t salt[PASSWORD_SALT_LEN], hash[32];
+    if (!random_bytes(salt, sizeof(salt))) return false;
+    pbkdf2_sha256(password, salt, sizeof(salt), iterations, hash);
+
+    char salt_hex[2 * PASSWORD_SALT_LEN + 1], hash_hex[65];
+    for (int i = 0; i < PASSWORD_SALT_LEN; i++) sprintf(salt_hex + 2 * i, "%02x", salt[i]);
+    for (int i = 0; i < 32; i++) sprintf(hash_hex + 2 * i, "%02x", hash[i]);
+
+    int n = snprintf(out, size, "$pbkdf2-sha256$%d$%s$%s", iterations, salt_hex, hash_hex);
+    return n > 0 && (size_t)n < size;
+}
+
+// Checks `password` against a stored hash or legacy plaintext. needs_rehash
+// is set on success when the entry should be rewritten at the current cost.
+bool verify_password(const char *stored, const char *password, bool *needs_rehash) {
+    *needs_rehash = false;
+
+    int iterations = 0, consumed = 0;
+    char salt_hex[2 * PASSWORD_SALT_LEN + 1], hash_hex[65];
+    if (sscanf(stored, "$pbkdf2-sha256$%d$%32[0-9a-f]$%64[0-9a-f]%n",
+               &iterations, salt_hex, hash_hex, &consumed) != 3 || stored[consumed] != '\0' ||
+        strlen(salt_hex) != 2 * PASSWORD_SALT_LEN || strlen(hash_hex) != 64 || iterations < 1) {
+        // Legacy plaintext: compare whole fixed-size buffers
+        char a[PASSWORD_HASH_LEN] = {0}, b[PASSWORD_HASH_LEN] = {0};
+        strncpy(a, stored, sizeof(a) - 1);
+        strncpy(b, password, sizeof(b) - 1);
+        bool ok = constant_time_equal(a, b, sizeof(a));
+        *needs_rehash = ok;
+        return ok;
+    }
+
+    uint8_t salt[PASSWORD_SALT_LEN], expected[32], actual[32];
+    for (int i = 0; i < PASSWORD_SALT_LEN; i++) {
+        unsigned int byte;
+        sscanf(salt_hex + 2 * i, "%2x", &byte);
+        salt[i] = (uint8_t)byte;
+    }
+    for (int i = 0; i < 32; i++) {
+        unsigned int byte;
+        sscanf(hash_hex + 2 * i, "%2x", &byte);
+        expected[i] = (uint8_t)byte;
+    }
+
+    pbkdf2_sha256(password, salt, sizeof(salt), iterations, actual);
+    bool ok = constant_time_equal(expected, actual, sizeof(actual));
+    *needs_rehash = ok && iterations != password_iterations;
+    return ok;
+}
+
+// A login burst would otherwise put one PBKDF2 per client thread on the
+// CPUs at once and starve book/cancel; waiting logins queue here instead.
+void begin_hashing() {
+#ifndef _WIN32
+    if (!serving) return;
+    pthread_mutex_lock(&hashing_lock);
+    while (hashing_slots == 0) pthread_cond_wait(&hashing_done, &hashing_lock);
+    hashing_slots--;
+    pthread_mutex_unlock(&hashing_lock);
+#endif
+}
+
+void end_hashing() {
+#ifndef _WIN32
+    if (!serving) return;
+    pthread_mutex_lock(&hashing_lock);
+    hashing_slots++;
+    pthread_cond_signal(&hashing_done);
+    pthread_mutex_unlock(&hashing_lock);
+#endif
+}
+
+void lock_users() {
+#ifndef _WIN32
+    if (serving) pthread_mutex_lock(&users_lock);
+#endif
+}
+
+void unlock_users() {
+#ifndef _WIN32
+    if (serving) pthread_mutex_unlock(&users_lock);
+#endif
+}
+
+// User index for a correct username/password, -1 otherwise. Unknown names
+// still pay for one hash so the reply time does not reveal which exist.
+// Plaintext and old-cost entries are rehashed and saved here.
+int authenticate(const char *username, const char *password) {
+    int i = find_user_by_name(username);
+
+    char stored[PASSWORD_HASH_LEN];
+    lock_users();
+    if (i != -1) strcpy(stored, users[i].password);
+    unlock_users();
+    if (i == -1) {
+        snprintf(stored, sizeof(stored), "$pbkdf2-sha256$%d$%032d$%064d", password_iterations, 0, 0);
+    }
+
+    bool needs_rehash;
+    begin_hashing();
+    bool ok = verify_password(stored, password, &needs_rehash);
+    end_hashing();
+    if (!ok || i == -1) return -1;
+
+    char upgraded[PASSWORD_HASH_LEN];
+    bool rehashed = false;
+    if (needs_rehash) {
+        begin_hashing();
+        rehashed = hash_password(password, password_iterations, upgraded, sizeof(upgraded));
+        end_hashing();
+    }
+    if (rehashed) {
+        lock_users();
+        strcpy(users[i].password, upgraded);
+        unlock_users();
+        if (!persist_users()) {
+            fprintf(stderr, "Warning: could not save the rehashed password for %s\n", username);
+        }
+    }
+    return i;
+}
+
+// Text Scanner
+// users.txt, rooms.txt and bookings.txt are mapped whole and tokenized by
+// hand: no stdio buffering, no locale-aware format parsing, and words are
+// handed out as pointers into the mapping.
+
+bool map_file(MappedFile *file, const char *path) {
+    memset(file, 0, sizeof(*file));
+#ifdef _WIN32
+    file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file->file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file->file, &size)) {
+        CloseHandle(file->file);
+        return false;
+    }
+    file->size = (size_t)size.QuadPart;
+    if (file->size > 0) {
+        file->mapping = CreateFileMappingA(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (file->mapping) file->data = MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0);
+        file->mapped = file->data != NULL;
+    }
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    file->size = (size_t)st.st_size;
+    if (file->size > 0) {
+        void *map = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(map, file->size, MADV_SEQUENTIAL);
+#endif
+            file->data = map;
+            file->mapped = true;
+        }
+    }
+    close(fd);
+#endif
+
+    // Files that cannot be mapped are read into memory instead
+    if (file->size > 0 && !file->mapped) {
+        char *copy = malloc(file->size);
+        FILE *fp = fopen(path, "rb");
+        bool ok = copy && fp && fread(copy, 1, file->size, fp) == file->size;
+        if (fp) fclose(fp);
+        if (!ok) {
+            free(copy);
+            unmap_file(file);
+            return false;
+        }
+        file->data = copy;
+    }
+    return true;
+}
+
+void unmap_file(MappedFile *file) {
+#ifdef _WIN32
+    if (file->mapped) UnmapViewOfFile(file->data);
+    if (file->mapping) CloseHandle(file->mapping);
+    if (file->file && file->file != INVALID_HANDLE_VALUE) CloseHandle(file->file);
+    file->mapping = file->file = NULL;
+#else
+    if (file->mapped) munmap((void *)file->data, file->size);
+#endif
+    if (!file->mapped) free((void *)file->data);
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = false;
+}
+
+bool open_text_scanner(TextScanner *scan, const char *path) {
+    scan->path = path;
+    scan->line = 1;
+    if (!map_file(&scan->file, path)) return false;
+    scan->pos = scan->file.data;
+    scan->end = scan->file.data ? scan->file.data + scan->file.size : NULL;
+    return true;
+}
+
+void close_text_scanner(TextScanner *scan) {
+    unmap_file(&scan->file);
+    scan->pos = scan->end = NULL;
+}
+
+// Reports where a file stopped making sense; always returns false
+bool scan_error(TextScanner *scan, const char *what) {
+    fprintf(stderr, "Warning: %s line %d: %s\n", scan->path, scan->line, what);
+    return false;
+}
+
+bool is_scan_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+// Skips whitespace including newlines, counting lines as it goes
+void scan_skip_space(TextScanner *scan) {
+    const char *p = scan->pos;
+    while (p < scan->end && is_scan_space(*p)) {
+        if (*p == '\n') scan->line++;
+        p++;
+    }
+    scan->pos = p;
+}
+
+// Skips blanks on the current line; true when nothing else is left on it
+bool scan_at_line_end(TextScanner *scan) {
+    const char *p = scan->pos;
+    while (p < scan->end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    scan->pos = p;
+    return p == scan->end || *p == '\n';
+}
+
+void scan_next_line(TextScanner *scan) {
+    const char *newline = scan->pos < scan->end ?
+                          memchr(scan->pos, '\n', (size_t)(scan->end - scan->pos)) : NULL;
+    if (!newline) {
+        scan->pos = scan->end;
+        return;
+    }
+    scan->pos = newline + 1;
+    scan->line++;
+}
+
+// A whole whitespace-delimited decimal token; "12x" is rejected, not split
+bool scan_int(TextScanner *scan, int *out) {
+    scan_skip_space(scan);
+    const char *p = scan->pos;
+    bool negative = p < scan->end && *p == '-';
+    if (p < scan->end && (*p == '-' || *p == '+')) p++;
+
+    const char *digits = p;
+    int64_t value = 0;
+    while (p < scan->end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        if (value > (int64_t)INT32_MAX + 1) return false;
+        p++;
+    }
+    if (p == digits || (p < scan->end && !is_scan_space(*p))) return false;
+    if (negative) value = -value;
+    if (value > INT32_MAX) return false;
+
+    *out = (int)value;
+    scan->pos = p;
+    return true;
+}
+
+// Next whitespace-delimited token, pointing into the file; 0 at end of file
+size_t scan_word(TextScanner *scan, const char **word) {
+    scan_skip_space(scan);
+    const char *p = scan->pos;
+    while (p < scan->end && !is_scan_space(*p)) p++;
+    *word = scan->pos;
+    size_t len = (size_t)(p - scan->pos);
+    scan->pos = p;
+    return len;
+}
+
+// Copies the next token into a fixed field; words that do not fit are errors
+bool scan_word_into(TextScanner *scan, char *out, size_t size) {
+    const char *word;
+    size_t len = scan_word(scan, &word);
+    if (len == 0 || len >= size) return false;
+    memcpy(out, word, len);
+    out[len] = '\0';
+    return true;
+}
+
+// Text File Operations
+
+bool file_exists(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (fp) {
+        fclose(fp);
+        return true;
+    }
+    return false;
+}
+
+// Crash-safe rewrites: the new copy goes to <path>.tmp, reaches the disk and
+// is renamed over the old one, so a crash or a full disk mid-save leaves the
+// previous file whole. The copy keeps the old file's permissions, so a
+// users.txt made private with chmod stays private.
+FILE *open_replacement(const char *path, char *temp, size_t size, const char *mode) {
+    snprintf(temp, size, "%s.tmp", path);
+    FILE *fp = fopen(temp, mode);
+#ifndef _WIN32
+    struct stat st;
+    if (fp && stat(path, &st) == 0 && fchmod(fileno(fp), st.st_mode & 07777) != 0) {
+        fclose(fp);
+        remove(temp);
+        return NULL;
+    }
+#endif
+    return fp;
+}
+
+bool replace_file(const char *temp, const char *path) {
+#ifdef _WIN32
+    return MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (rename(temp, path) != 0) return false;
+
+    // The rename only survives power loss once its directory is synced
+    char dir[FILENAME_MAX] = ".";
+    const char *slash = strrchr(path, '/');
+    if (slash) snprintf(dir, sizeof(dir), "%.*s", slash == path ? 1 : (int)(slash - path), path);
+    int fd = open(dir, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    return true;
+#endif
+}
+
+// Finishes open_replacement(); `ok` is false when writing the copy failed
+bool commit_replacement(FILE *fp, const char *temp, const char *path, bool ok) {
+    if (ok) ok = !ferror(fp) && sync_file(fp);
+    if (fclose(fp) != 0) ok = false;
+    if (ok) ok = replace_file(temp, path);
+    if (!ok) remove(temp);
+    return ok;
+}
+
+bool save_users() {
+    char temp[FILENAME_MAX];
+    FILE *fp = open_replacement(USERS_FILE, temp, sizeof(temp), "w");
+    if (!fp) return false;
+
+    fprintf(fp, "%d\n", user_count);
+
+    for (int i = 0; i < user_count; i++) {
+        fprintf(fp, "%s %s %d\n",
+               users[i].username,
+               users[i].password,
+               users[i].is_admin ? 1 : 0);
+    }
+
+    return commit_replacement(fp, temp, USERS_FILE, true);
+}
+
+bool load_users() {
+    TextScanner scan;
+    if (!open_text_scanner(&scan, USERS_FILE)) return false;
+
+    // Each user takes at least a line, which bounds a damaged count
+    int count;
+    bool ok = scan_int(&scan, &count) && count >= 0 && count <= scan.end - scan.pos &&
+              reserve_users(count);
+    if (!ok) scan_error(&scan, "expected the number of users");
+
+    for (int i = 0; ok && i < count; i++) {
+        int is_admin;
+        if (!scan_word_into(&scan, users[i].username, sizeof(users[i].username))) {
+            ok = scan_error(&scan, "expected a username");
+        } else if (!scan_word_into(&scan, users[i].password, sizeof(users[i].password))) {
+            ok = scan_error(&scan, "expected a password");
+        } else if (!scan_int(&scan, &is_admin)) {
+            ok = scan_error(&scan, "expected 1 or 0 for the admin flag");
+        } else {
+            users[i].is_admin = (is_admin == 1);
+        }
+    }
+
+    close_text_scanner(&scan);
+    if (!ok) return false;
+    user_count = count;
+    return rebuild_user_index();
+}
+
+// Rooms are stored in rooms.dat: a fixed header followed by one fixed-size
+// record per room, so a single slot change rewrites only its day word.
+size_t room_record_offset(int room_index) {
+    return sizeof(RoomsFileHeader) + (size_t)room_index * sizeof(RoomRecord);
+}
+
+bool save_rooms() {
+    char temp[FILENAME_MAX];
+    FILE *fp = open_replacement(ROOMS_DB_FILE, temp, sizeof(temp), "wb");
+    if (!fp) return false;
+
+    RoomsFileHeader header = {0};
+    memcpy(header.magic, ROOMS_DB_MAGIC, sizeof(header.magic));
+    header.version = ROOMS_DB_VERSION;
+    header.record_size = sizeof(RoomRecord);
+    header.room_count = (uint32_t)room_count;
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    for (int i = 0; ok && i < room_count; i++) {
+        RoomRecord rec = {0};
+        rec.id = rooms[i].id;
+        memcpy(rec.department, rooms[i].department, sizeof(rec.department));
+        memcpy(rec.type, rooms[i].type, sizeof(rec.type));
+        memcpy(rec.schedule, rooms[i].schedule, sizeof(rec.schedule));
+        ok = fwrite(&rec, sizeof(rec), 1, fp) == 1;
+    }
+
+    return commit_replacement(fp, temp, ROOMS_DB_FILE, ok);
+}
+
+// Writes back the single day word of one room in place
+bool write_room_day(FILE *fp, int room_index, int day) {
+    return write_room_word(fp, room_index, day, rooms[room_index].schedule[day]);
+}
+
+bool write_room_word(FILE *fp, int room_index, int day, uint32_t word) {
+    long offset = (long)(room_record_offset(room_index) +
+                         offsetof(RoomRecord, schedule) + (size_t)day * sizeof(uint32_t));
+    return fseek(fp, offset, SEEK_SET) == 0 && fwrite(&word, sizeof(word), 1, fp) == 1;
+}
+
+bool load_rooms() {
+    if (!file_exists(ROOMS_DB_FILE)) {
+        return file_exists(ROOMS_FILE) && migrate_rooms_text();
+    }
+
+    FILE *fp = fopen(ROOMS_DB_FILE, "rb");
+    if (!fp) return false;
+
+    // A damaged count must not size the tables beyond what the file holds
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    rewind(fp);
+
+    RoomsFileHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, ROOMS_DB_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != ROOMS_DB_VERSION ||
+        header.record_size != sizeof(RoomRecord) ||
+        file_size < (long)sizeof(header) ||
+        header.room_count > ((size_t)file_size - sizeof(header)) / sizeof(RoomRecord) ||
+        header.room_count > INT32_MAX ||
+        !reserve_rooms((int)header.room_count)) {
+        fclose(fp);
+        return false;
+    }
+
+    // One read for the whole table; the layout is fixed so no parsing is needed
+    RoomRecord *records = malloc((header.room_count + 1) * sizeof(RoomRecord));
+    if (!records || fread(records, sizeof(RoomRecord), header.room_count, fp) != header.room_count) {
+        free(records);
+        fclose(fp);
+        return false;
+    }
+    fclose(fp);
+
+    room_count = (int)header.room_count;
+    for (int i = 0; i < room_count; i++) {
+        rooms[i].id = records[i].id;
+        memcpy(rooms[i].department, records[i].department, sizeof(rooms[i].department));
+        rooms[i].department[sizeof(rooms[i].department)-1] = '\0';
+        memcpy(rooms[i].type, records[i].type, sizeof(rooms[i].type));
+        rooms[i].type[sizeof(rooms[i].type)-1] = '\0';
+        memcpy(rooms[i].schedule, records[i].schedule, sizeof(rooms[i].schedule));
+    }
+    free(records);
+    return rebuild_room_index() && rebuild_room_groups();
+}
+
+bool load_rooms_text() {
+    TextScanner scan;
+    if (!open_text_scanner(&scan, ROOMS_FILE)) return false;
+
+    int count;
+    bool ok = scan_int(&scan, &count) && count >= 0 && reserve_rooms(count);
+    if (!ok) scan_error(&scan, "expected the number of rooms");
+
+    for (int i = 0; ok && i < count; i++) {
+        if (!scan_int(&scan, &rooms[i].id)) {
+            ok = scan_error(&scan, "expected a room ID");
+        } else if (!scan_word_into(&scan, rooms[i].department, sizeof(rooms[i].department))) {
+            ok = scan_error(&scan, "expected a department");
+        } else if (!scan_word_into(&scan, rooms[i].type, sizeof(rooms[i].type))) {
+            ok = scan_error(&scan, "expected a room type");
+        }
+
+        // 7 days x 24 hours of 1 (booked) or 0, folded straight into the day words
+        for (int d = 0; ok && d < 7; d++) {
+            uint32_t word = 0;
+            for (int h = 0; h < 24; h++) {
+                int booked;
+                if (!scan_int(&scan, &booked)) {
+                    ok = scan_error(&scan, "expected 24 slot values per day");
+                    break;
+                }
+                if (booked == 1) word |= 1u << h;
+            }
+            rooms[i].schedule[d] = word;
+        }
+    }
+
+    close_text_scanner(&scan);
+    if (!ok) return false;
+    room_count = count;
+    return rebuild_room_index() && rebuild_room_groups();
+}
+
+// One-time conversion of a text rooms.txt into rooms.dat
+bool migrate_rooms_text() {
+    if (!load_rooms_text() || !save_rooms()) return false;
+
+    char backup[FILENAME_MAX];
+    snprintf(backup, sizeof(backup), "%s.migrated", ROOMS_FILE);
+    remove(backup);
+    if (rename(ROOMS_FILE, backup) != 0) {
+        printf("Warning: rooms migrated to %s but %s could not be renamed.\n",
+               ROOMS_DB_FILE, ROOMS_FILE);
+    }
+    return true;
+}
+
+// Write-Ahead Log
+// book/cancel append one small record to rooms.wal instead of touching
+// rooms.dat. Every WAL_CHECKPOINT_INTERVAL records the changed day words
+// are written back to rooms.dat and the log is truncated. In server mode the
+// flusher thread holds every room lock only to copy those words and move the
+// log aside as rooms.wal.old, which is deleted once rooms.dat is synced.
+// Records are absolute (set or clear a slot), so replaying one twice is
+// harmless.
+
+uint8_t wal_record_check(const WalRecord *rec) {
+    uint32_t id = (uint32_t)rec->room_id;
+    return (uint8_t)(0xA5 ^ (id & 0xFF) ^ ((id >> 8) & 0xFF) ^ ((id >> 16) & 0xFF) ^
+                     (id >> 24) ^ rec->day ^ rec->hour ^ rec->booked);
+}
+
+bool sync_file(FILE *fp) {
+    if (fflush(fp) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+void lock_wal() {
+#ifndef _WIN32
+    if (serving) pthread_mutex_lock(&wal_lock);
+#endif
+}
+
+void unlock_wal() {
+#ifndef _WIN32
+    if (serving) pthread_mutex_unlock(&wal_lock);
+#endif
+}
+
+bool open_rooms_wal() {
+    wal_fp = fopen(ROOMS_WAL_FILE, "ab");
+    return wal_fp != NULL;
+}
+
+bool wal_append(int room_index, int day, int hour, bool booked) {
+    return wal_append_range(room_index, 1 << day, hour, 1, booked);
+}
+
+// One record covers a whole range/recurring change, so it commits or not as a unit
+bool wal_append_range(int room_index, int day_mask, int hour, int hours, bool booked) {
+    if (!wal_fp && !open_rooms_wal()) return false;
+
+    WalRecord rec;
+    rec.room_id = rooms[room_index].id;
+    rec.day = (uint8_t)(WAL_DAY_SET | day_mask);
+    rec.hour = (uint8_t)hour;
+    rec.booked = (uint8_t)((booked ? 1 : 0) | (hours << 1));
+    rec.check = wal_record_check(&rec);
+
+    lock_wal();
+    if (fwrite(&rec, sizeof(rec), 1, wal_fp) != 1) {
+        unlock_wal();
+        return false;
+    }
+    room_dirty_days[room_index] |= (uint8_t)day_mask; // guarded by the room's lock
+    wal_unsynced++;
+    wal_records++;
+
+    // Batch mode leaves the record in the stdio buffer until its final flush
+    if (defer_writes) {
+        unlock_wal();
+        return true;
+    }
+
+    // fflush hands the record to the OS so it survives a process crash;
+    // the fsync for power loss is batched across WAL_SYNC_BATCH records.
+    // A failed fsync is retried on the next append rather than failing this
+    // one: the record already reached the OS, so rolling the booking back
+    // would let a later replay resurrect it.
+    bool ok = fflush(wal_fp) == 0;
+    if (ok && wal_unsynced >= WAL_SYNC_BATCH && sync_file(wal_fp)) {
+        wal_unsynced = 0;
+    }
+    bool due = wal_records >= WAL_CHECKPOINT_INTERVAL;
+    unlock_wal();
+
+    // The caller holds a room lock, so server mode hands the checkpoint off
+    if (ok && due) {
+        if (serving) request_checkpoint(); else checkpoint_rooms();
+    }
+    return ok;
+}
+
+// Writes the dirty day words back to rooms.dat, then empties the WAL
+bool checkpoint_rooms() {
+    FILE *fp = fopen(ROOMS_DB_FILE, "r+b");
+    if (!fp) return false;
+
+    bool ok = true;
+    for (int i = 0; ok && i < room_count; i++) {
+        for (int d = 0; ok && d < 7; d++) {
+            if (room_dirty_days[i] & (1u << d)) {
+                ok = write_room_day(fp, i, d);
+            }
+        }
+    }
+    if (ok) ok = sync_file(fp);
+    if (fclose(fp) != 0) ok = false;
+    if (!ok) return false; // keep the WAL; it is still the source of truth
+
+    memset(room_dirty_days, 0, (size_t)room_count * sizeof(*room_dirty_days));
+
+    if (wal_fp) fclose(wal_fp);
+    wal_fp = fopen(ROOMS_WAL_FILE, "wb");
+    wal_records = 0;
+    wal_unsynced = 0;
+    remove(ROOMS_WAL_OLD_FILE); // replayed at startup, now in rooms.dat
+    return wal_fp != NULL;
+}
+
+// Asks the server flusher to fold rooms.wal into rooms.dat
+void request_checkpoint() {
+#ifndef _WIN32
+    pthread_mutex_lock(&persist_lock);
+    checkpoint_due = true;
+    pthread_cond_signal(&persist_wake);
+    pthread_mutex_unlock(&persist_lock);
+#endif
+}
+
+// Stops every book/cancel (all room stripes, then the WAL) only while the
+// dirty day words are copied and the log is rotated; rooms.dat is written
+// and synced after they are released
+bool checkpoint_rooms_while_serving() {
+#ifndef _WIN32
+    DayWordCopy *copies = malloc(((size_t)room_count * 7 + 1) * sizeof(*copies));
+    if (!copies) return false;
+
+    for (int i = 0; i < ROOM_LOCK_STRIPES; i++) pthread_mutex_lock(&room_locks[i]);
+    pthread_mutex_lock(&wal_lock);
+    int copied = 0;
+    bool rotated = rotate_rooms_wal();
+    if (rotated) {
+        for (int i = 0; i < room_count; i++) {
+            for (int d = 0; room_dirty_days[i] && d < 7; d++) {
+                if (!(room_dirty_days[i] & (1u << d))) continue;
+                copies[copied].room_index = i;
+                copies[copied].day = d;
+                copies[copied].word = rooms[i].schedule[d];
+                copied++;
+            }
+        }
+        memset(room_dirty_days, 0, (size_t)room_count * sizeof(*room_dirty_days));
+    }
+    pthread_mutex_unlock(&wal_lock);
+    for (int i = ROOM_LOCK_STRIPES - 1; i >= 0; i--) pthread_mutex_unlock(&room_locks[i]);
+
+    bool ok = rotated;
+    if (ok) {
+        FILE *fp = fopen(ROOMS_DB_FILE, "r+b");
+        ok = fp != NULL;
+        for (int c = 0; ok && c < copied; c++) {
+            ok = write_room_word(fp, copies[c].room_index, copies[c].day, copies[c].word);
+        }
+        if (ok) ok = sync_file(fp);
+        if (fp && fclose(fp) != 0) ok = false;
+    }
+
+    if (ok) {
+        remove(ROOMS_WAL_OLD_FILE);
+    } else if (rotated) {
+        // rooms.wal.old stays; the next checkpoint writes these days again
+        for (int c = 0; c < copied; c++) {
+            lock_room(copies[c].room_index);
+            room_dirty_days[copies[c].room_index] |= (uint8_t)(1u << copies[c].day);
+            unlock_room(copies[c].room_index);
+        }
+    }
+    free(copies);
+    return ok;
+#else
+    return checkpoint_rooms();
+#endif
+}
+
+// Moves the log aside as rooms.wal.old and starts an empty one; caller holds
+// the WAL lock. A rooms.wal.old left by a failed checkpoint still has days
+// rooms.dat lacks, so the log is added to its end instead.
+bool rotate_rooms_wal() {
+    if (wal_fp) fclose(wal_fp);
+    wal_fp = NULL;
+
+    bool ok = file_exists(ROOMS_WAL_OLD_FILE) ? append_file(ROOMS_WAL_FILE, ROOMS_WAL_OLD_FILE)
+                                              : rename(ROOMS_WAL_FILE, ROOMS_WAL_OLD_FILE) == 0;
+    wal_fp = fopen(ROOMS_WAL_FILE, ok ? "wb" : "ab");
+    if (ok) {
+        wal_records = 0;
+        wal_unsynced = 0;
+    }
+    return ok && wal_fp != NULL;
+}
+
+bool append_file(const char *from, const char *to) {
+    FILE *in = fopen(from, "rb");
+    if (!in) return false;
+    FILE *out = fopen(to, "ab");
+    if (!out) {
+        fclose(in);
+        return false;
+    }
+
+    char buffer[4096];
+    size_t n;
+    bool ok = true;
+    while (ok && (n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        ok = fwrite(buffer, 1, n, out) == n;
+    }
+    if (ferror(in)) ok = false;
+    fclose(in);
+    if (fclose(out) != 0) ok = false;
+    return ok;
+}
+
+// Applies records left behind by a session that did not checkpoint: a
+// rotated log first, then the current one
+int replay_rooms_wal() {
+    return replay_wal_file(ROOMS_WAL_OLD_FILE) + replay_wal_file(ROOMS_WAL_FILE);
+}
+
+int replay_wal_file(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+
+    int applied = 0;
+    WalRecord rec;
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        // Older records name a single day and hour
+        int day_mask = (rec.day & WAL_DAY_SET) ? (rec.day & 0x7F) : (rec.day <= 6 ? 1 << rec.day : 0);
+        int hours = (rec.booked >> 1) ? (rec.booked >> 1) : 1;
+        if (rec.check != wal_record_check(&rec) || day_mask == 0 || rec.hour + hours > 24) {
+            break; // torn tail from a crash mid-append
+        }
+        int room_index = find_room_by_id(rec.room_id);
+        if (room_index == -1) continue;
+
+        for (int d = 0; d < 7; d++) {
+            if (!(day_mask & (1 << d))) continue;
+            for (int h = rec.hour; h < rec.hour + hours; h++) {
+                set_slot_booked(&rooms[room_index], d, h, (rec.booked & 1) != 0);
+            }
+        }
+        room_dirty_days[room_index] |= (uint8_t)day_mask;
+        applied++;
+    }
+    fclose(fp);
+    return applied;
+}
+
+void close_rooms_wal() {
+    checkpoint_rooms();
+    if (wal_fp) {
+        fclose(wal_fp);
+        wal_fp = NULL;
+    }
+}
+
+// Booking Log
+// bookings.dat holds one fixed-width BookingLogRecord per book/cancel, so
+// readers stream it in large freads instead of parsing text. A sparse index
+// keeps the newest timestamp seen up to every LOG_INDEX_BLOCK-th record;
+// history readers binary-search it to seek straight to a time window.
+
+long booking_record_offset(long record) {
+    return (long)sizeof(BookingsFileHeader) + record * (long)sizeof(BookingLogRecord);
+}
+
+// Whole records in an open bookings.dat, or -1 if the header does not match
+long booking_log_records(FILE *fp) {
+    BookingsFileHeader header;
+    if (fseek(fp, 0, SEEK_END) != 0) return -1;
+    long size = ftell(fp);
+    rewind(fp);
+    if (size < (long)sizeof(header) ||
+        fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, BOOKINGS_DB_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != BOOKINGS_DB_VERSION ||
+        header.record_size != sizeof(BookingLogRecord)) {
+        return -1;
+    }
+    return (size - (long)sizeof(header)) / (long)sizeof(BookingLogRecord);
+}
+
+void lock_booking_log() {
+#ifndef _WIN32
+    if (serving) pthread_mutex_lock(&booking_log_lock);
+#endif
+}
+
+void unlock_booking_log() {
+#ifndef _WIN32
+    if (serving) pthread_mutex_unlock(&booking_log_lock);
+#endif
+}
+
+bool open_booking_log() {
+    FILE *fp = fopen(BOOKINGS_FILE, "r+b");
+    if (!fp) fp = fopen(BOOKINGS_FILE, "w+b");
+    if (!fp) return false;
+
+    fseek(fp, 0, SEEK_END);
+    long records = 0;
+    if (ftell(fp) == 0) {
+        BookingsFileHeader header = {0};
+        memcpy(header.magic, BOOKINGS_DB_MAGIC, sizeof(header.magic));
+        header.version = BOOKINGS_DB_VERSION;
+        header.record_size = sizeof(BookingLogRecord);
+        if (fwrite(&header, sizeof(header), 1, fp) != 1 || fflush(fp) != 0) {
+            fclose(fp);
+            return false;
+        }
+    } else if ((records = booking_log_records(fp)) < 0) {
+        fclose(fp);
+        return false;
+    }
+
+    // Appends start after the last whole record, overwriting any torn tail
+    if (fseek(fp, booking_record_offset(records), SEEK_SET) != 0) {
+        fclose(fp);
+        return false;
+    }
+    booking_log_fp = fp;
+    return true;
+}
+
+void close_booking_log() {
+    if (booking_log_fp) {
+        fclose(booking_log_fp);
+        booking_log_fp = NULL;
+    }
+}
+
+// Counts a record and extends the sparse time index; caller holds the log lock
+bool index_log_record(int64_t timestamp) {
+    if (log_record_count % LOG_INDEX_BLOCK == 0) {
+        if (log_block_count == log_block_capacity) {
+            size_t capacity = grown_capacity(log_block_capacity, log_block_count + 1, sizeof(*log_block_times));
+            int64_t *grown = capacity ? realloc(log_block_times, capacity * sizeof(*grown)) : NULL;
+            if (!grown) return false;
+            log_block_times = grown;
+            log_block_capacity = (int)capacity;
+        }
+        if (log_record_count == 0 || timestamp > log_max_time) log_max_time = timestamp;
+        log_block_times[log_block_count++] = log_max_time;
+    } else if (timestamp > log_max_time) {
+        log_max_time = timestamp;
+    }
+    log_record_count++;
+    return true;
+}
+
+// Record number to start streaming from for records at or after `since`
+long first_log_record_since(int64_t since) {
+    // Entries are non-decreasing; find the last block whose prefix is all older
+    int lo = 0, hi = log_block_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (log_block_times[mid] < since) lo = mid + 1; else hi = mid;
+    }
+    return lo > 0 ? (long)(lo - 1) * LOG_INDEX_BLOCK : 0;
+}
+
+// Appends one record and returns its record number, or -1; caller holds the log lock
+long write_log_record(const BookingLogRecord *rec) {
+    if (!booking_log_fp && !open_booking_log()) return -1;
+
+    long record = log_record_count;
+    if (fwrite(rec, sizeof(*rec), 1, booking_log_fp) != 1) return -1;
+    index_log_record(rec->timestamp);
+    if (!(rec->flags & LOG_FLAG_SNAPSHOT)) {
+        tally_log_record(&log_tally, rec->action, rec->day_mask, rec->hour, rec->hours, rec->flags);
+    }
+    if (!defer_writes && fflush(booking_log_fp) != 0) return -1;
+    return record;
+}
+
+bool append_booking_record_with_action(int room_id, int day, int hour, int user_index, char action) {
+    return append_booking_range_record(room_id, 1 << day, hour, 1, user_index, action);
+}
+
+bool append_booking_range_record(int room_id, int day_mask, int hour, int hours, int user_index, char action) {
+    BookingLogRecord rec = {0};
+    rec.timestamp = (int64_t)time(NULL);
+    rec.room_id = room_id;
+    rec.user_id = user_index;
+    while (!(day_mask & (1 << rec.day))) rec.day++;
+    rec.hour = (uint8_t)hour;
+    rec.hours = (uint8_t)hours;
+    rec.day_mask = (uint8_t)day_mask;
+    rec.action = action;
+
+    // The per-user lists are shared across rooms, so they update under the log lock too
+    lock_booking_log();
+    long record = write_log_record(&rec);
+    if (record >= 0) record_range_action(room_id, day_mask, hour, hours, user_index, action, record);
+    unlock_booking_log();
+    return record >= 0;
+}
+
+bool open_log_reader(BookingLogReader *reader, long first_record) {
+    // Pending appends must reach the file before it is read back
+    if (booking_log_fp) fflush(booking_log_fp);
+
+    reader->fp = fopen(BOOKINGS_FILE, "rb");
+    if (!reader->fp) return false;
+
+    reader->end = booking_log_records(reader->fp);
+    if (reader->end < 0 ||
+        fseek(reader->fp, booking_record_offset(first_record), SEEK_SET) != 0) {
+        fclose(reader->fp);
+        reader->fp = NULL;
+        return false;
+    }
+    reader->count = 0;
+    reader->pos = 0;
+    reader->next = first_record;
+    return true;
+}
+
+// Torn or corrupt records are skipped but keep their record number
+bool log_record_valid(const BookingLogRecord *rec) {
+    int slots_per_day = (rec->flags & LOG_FLAG_QUARTERS) ? 96 : 24;
+    return rec->day <= 6 && rec->hours >= 1 && rec->hour + rec->hours <= slots_per_day &&
+           (rec->day_mask & (1 << rec->day)) && rec->day_mask <= 127;
+}
+
+// Next valid record straight from the read buffer; NULL at the end of the log
+const BookingLogRecord *next_raw_log_record(BookingLogReader *reader) {
+    while (reader->next < reader->end) {
+        if (reader->pos == reader->count) {
+            long left = reader->end - reader->next;
+            size_t want = left < LOG_READ_BATCH ? (size_t)left : LOG_READ_BATCH;
+            reader->count = (int)fread(reader->buf, sizeof(BookingLogRecord), want, reader->fp);
+            reader->pos = 0;
+            if (reader->count == 0) return NULL;
+        }
+
+        const BookingLogRecord *rec = &reader->buf[reader->pos++];
+        reader->next++;
+        if (log_record_valid(rec)) return rec;
+    }
+    return NULL;
+}
+
+// Next valid record, decoded with its username; false at the end of the log
+bool next_log_record(BookingLogReader *reader, BookingRecord *out) {
+    const BookingLogRecord *rec = next_raw_log_record(reader);
+    if (!rec) return false;
+
+    out->room_id = rec->room_id;
+    out->day = rec->day;
+    out->hour = rec->hour;
+    out->hours = rec->hours;
+    out->day_mask = rec->day_mask;
+    out->action = rec->action;
+    out->flags = rec->flags;
+    out->week = rec->week;
+    out->timestamp = rec->timestamp;
+    out->user = log_user(rec->user_id);
+    // Every source fits username[]; strcpy keeps this off the printf path
+    strcpy(out->username, user_display_name(out->user));
+    return true;
+}
+
+void close_log_reader(BookingLogReader *reader) {
+    if (reader->fp) {
+        fclose(reader->fp);
+        reader->fp = NULL;
+    }
+}
+
+// One bookings.txt line: room day hour action user [hours day_mask [week [minute length]]]
+// A sub-hour booking starts `minute` past `hour` and lasts `length` minutes;
+// `hours` is then the hours it touches. Files written with a single 1 after
+// the week (hour and hours in quarter-hours) are still read. Fields never
+// continue onto the next line.
+bool scan_booking_line(TextScanner *scan, BookingRecord *rec) {
+    int minute = 0, length = 0;
+    const char *action;
+    rec->week = 0;
+    if (scan_at_line_end(scan) || !scan_int(scan, &rec->room_id) ||
+        scan_at_line_end(scan) || !scan_int(scan, &rec->day) ||
+        scan_at_line_end(scan) || !scan_int(scan, &rec->hour) ||
+        scan_at_line_end(scan) || scan_word(scan, &action) != 1 ||
+        scan_at_line_end(scan) || !scan_word_into(scan, rec->username, sizeof(rec->username))) {
+        return false;
+    }
+    rec->action = action[0];
+
+    int *optional[] = {&rec->hours, &rec->day_mask, &rec->week, &minute, &length};
+    int fields = 5;
+    while (fields < 10 && !scan_at_line_end(scan)) {
+        if (!scan_int(scan, optional[fields - 5])) return false;
+        fields++;
+    }
+    if (!scan_at_line_end(scan)) return false;
+
+    bool quarters = fields == 9 && minute == 1;
+    int slots_per_day = quarters ? 96 : 24;
+    if ((fields == 9 && !quarters) || rec->day < 0 || rec->day > 6 || rec->hour < 0 ||
+        rec->hour >= slots_per_day) {
+        return false;
+    }
+    if (fields < 7) {
+        rec->hours = 1;
+        rec->day_mask = 1 << rec->day;
+    }
+    rec->user = -1;
+    rec->timestamp = 0;
+    rec->flags = 0;
+    if (rec->hours < 1 || rec->hour + rec->hours > slots_per_day || rec->day_mask <= 0 ||
+        rec->day_mask >= 128 || rec->week < 0 || rec->week > UINT16_MAX) {
+        return false;
+    }
+    if (quarters) {
+        rec->flags = LOG_FLAG_QUARTERS;
+    } else if (fields == 10) {
+        // Stored like a booking: hour and hours in quarter-hours
+        int start = rec->hour * 60 + minute;
+        if (minute < 0 || minute >= 60 || minute % 15 != 0 || length < 15 || length % 15 != 0 ||
+            start + length > MINUTES_PER_DAY) {
+            return false;
+        }
+        rec->hour = start / 15;
+        rec->hours = length / 15;
+        rec->flags = LOG_FLAG_QUARTERS;
+    }
+    return true;
+}
+
+// Next readable bookings.txt record; blank lines are skipped and bad ones
+// reported with their line number. False at the end of the file.
+bool next_booking_text_record(TextScanner *scan, BookingRecord *rec) {
+    while (scan->pos < scan->end) {
+        if (scan_at_line_end(scan)) {
+            scan_next_line(scan);
+            continue;
+        }
+        bool ok = scan_booking_line(scan, rec);
+        if (!ok) scan_error(scan, "unreadable booking skipped");
+        scan_next_line(scan);
+        if (ok) return true;
+    }
+    return false;
+}
+
+// One-time conversion of a text bookings.txt into bookings.dat. The text
+// format has no times, so every record gets the file's modification time.
+bool migrate_bookings_text() {
+    struct stat st;
+    int64_t timestamp = stat(BOOKINGS_TEXT_FILE, &st) == 0 ? (int64_t)st.st_mtime : 0;
+
+    TextScanner scan;
+    if (!open_text_scanner(&scan, BOOKINGS_TEXT_FILE)) return false;
+    if (!open_booking_log()) {
+        close_text_scanner(&scan);
+        return false;
+    }
+
+    bool ok = true;
+    int known_names = history_name_count;
+    BookingRecord text;
+    while (ok && next_booking_text_record(&scan, &text)) {
+        // Accounts deleted since keep their name in the history
+        int user = find_user_by_name(text.username);
+        if (user == -1) user = add_history_name(text.username);
+
+        BookingLogRecord rec = {0};
+        rec.timestamp = timestamp;
+        rec.room_id = text.room_id;
+        rec.user_id = user;
+        rec.day = (uint8_t)text.day;
+        rec.hour = (uint8_t)text.hour;
+        rec.hours = (uint8_t)text.hours;
+        rec.day_mask = (uint8_t)text.day_mask;
+        rec.action = text.action;
+        rec.week = (uint16_t)text.week;
+        rec.flags = (uint8_t)text.flags;
+        ok = fwrite(&rec, sizeof(rec), 1, booking_log_fp) == 1;
+    }
+    close_text_scanner(&scan);
+    if (ok) ok = fflush(booking_log_fp) == 0 && sync_file(booking_log_fp);
+    close_booking_log();
+    if (ok && history_name_count > known_names) ok = save_history_names();
+
+    if (!ok) {
+        remove(BOOKINGS_FILE); // retry the migration next start
+        return false;
+    }
+
+    char backup[FILENAME_MAX];
+    snprintf(backup, sizeof(backup), "%s.migrated", BOOKINGS_TEXT_FILE);
+    remove(backup);
+    if (rename(BOOKINGS_TEXT_FILE, backup) != 0) {
+        printf("Warning: bookings migrated to %s but %s could not be renamed.\n",
+               BOOKINGS_FILE, BOOKINGS_TEXT_FILE);
+    }
+    return true;
+}
+
+// Names in old history with no account live in bookings.names next to
+// bookings.dat, one per line, and records point at them with negative user
+// ids. They never enter users[], so nobody can sign in as them and the names
+// stay free to register.
+bool load_history_names() {
+    if (!file_exists(BOOKINGS_NAMES_FILE)) return true;
+
+    TextScanner scan;
+    if (!open_text_scanner(&scan, BOOKINGS_NAMES_FILE)) return false;
+    bool ok = true;
+    const char *word;
+    size_t len;
+    while (ok && (len = scan_word(&scan, &word)) > 0) {
+        char name[sizeof(*history_names)];
+        if (len >= sizeof(name)) {
+            ok = scan_error(&scan, "name too long");
+            break;
+        }
+        memcpy(name, word, len);
+        name[len] = '\0';
+        ok = add_history_name(name) != -1;
+    }
+    close_text_scanner(&scan);
+    return ok;
+}
+
+bool save_history_names() {
+    char temp[FILENAME_MAX];
+    FILE *fp = open_replacement(BOOKINGS_NAMES_FILE, temp, sizeof(temp), "w");
+    if (!fp) return false;
+
+    for (int k = 0; k < history_name_count; k++) fprintf(fp, "%s\n", history_names[k]);
+    return commit_replacement(fp, temp, BOOKINGS_NAMES_FILE, true);
+}
+
+// User id for `username` in the history name table, added if new; -1 if
+// the table cannot grow
+int add_history_name(const char *username) {
+    for (int k = 0; k < history_name_count; k++) {
+        if (strcmp(history_names[k], username) == 0) return HISTORY_NAME_USER(k);
+    }
+    if (!grow_array((void **)&history_names, &history_name_capacity, history_name_count + 1,
+                    sizeof(*history_names))) {
+        return -1;
+    }
+    snprintf(history_names[history_name_count], sizeof(*history_names), "%s", username);
+    return HISTORY_NAME_USER(history_name_count++);
+}
+
+// A logged user id as BookingRecord::user: -1 unless it names a user or a
+// history name that still exists
+int log_user(int64_t user_id) {
+    if (user_id >= 0 && user_id < user_count) return (int)user_id;
+    if (user_id <= HISTORY_NAME_USER(0) && HISTORY_NAME_USER(user_id) < history_name_count) {
+        return (int)user_id;
+    }
+    return -1;
+}
+
+const char *user_display_name(int user) {
+    if (user >= 0) return users[user].username;
+    if (user <= HISTORY_NAME_USER(0)) return history_names[HISTORY_NAME_USER(user)];
+    return "(unknown)";
+}
+
+// Writes the log in the old bookings.txt format, optionally only the last
+// `max_age_days`
+int export_booking_log(const char *path, int max_age_days) {
+    FILE *out = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    int64_t since = max_age_days > 0 ? (int64_t)time(NULL) - (int64_t)max_age_days * 86400 : 0;
+    BookingLogReader reader;
+    if (!open_log_reader(&reader, max_age_days > 0 ? first_log_record_since(since) : 0)) {
+        fprintf(stderr, "Cannot read %s\n", BOOKINGS_FILE);
+        if (out != stdout) fclose(out);
+        return 1;
+    }
+
+    BookingRecord rec;
+    long exported = 0;
+    while (next_log_record(&reader, &rec)) {
+        if (rec.timestamp < since) continue;
+        if (rec.flags & LOG_FLAG_QUARTERS) {
+            // The hours it touches, then the minute offset and exact length
+            int start, end;
+            record_minutes(rec.hour, rec.hours, rec.flags, &start, &end);
+            fprintf(out, "%d %d %d %c %s %d %d %d %d %d\n", rec.room_id, rec.day, start / 60,
+                    rec.action, rec.username, (end + 59) / 60 - start / 60, rec.day_mask, rec.week,
+                    start % 60, end - start);
+        } else if (rec.week > 0) {
+            fprintf(out, "%d %d %d %c %s %d %d %d\n", rec.room_id, rec.day, rec.hour,
+                    rec.action, rec.username, rec.hours, rec.day_mask, rec.week);
+        } else if (rec.hours == 1 && rec.day_mask == (1 << rec.day)) {
+            fprintf(out, "%d %d %d %c %s\n",
+                    rec.room_id, rec.day, rec.hour, rec.action, rec.username);
+        } else {
+            fprintf(out, "%d %d %d %c %s %d %d\n", rec.room_id, rec.day, rec.hour,
+                    rec.action, rec.username, rec.hours, rec.day_mask);
+        }
+        exported++;
+    }
+    close_log_reader(&reader);
+
+    bool ok = fflush(out) == 0;
+    if (out != stdout && fclose(out) != 0) ok = false;
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        return 1;
+    }
+    fprintf(stderr, "Exported %ld booking records.\n", exported);
+    return 0;
+}
+
+// Keeps slot_history and the per-user lists in step with the log so
+// lookups never reread it
+void record_slot_action(int room_id, int day, int hour, int user_index, char action, long record) {
+    if (day < 0 || day > 6 || hour < 0 || hour > 23) return;
+    record_range_action(room_id, 1 << day, hour, 1, user_index, action, record);
+}
+
+void record_range_action(int room_id, int day_mask, int hour, int hours, int user_index, char action, long record) {
+    int room_index = find_room_by_id(room_id);
+    if (room_index == -1) return;
+
+    if (user_index >= 0) add_user_history(user_index, record, false);
+
+    int told = -1; // previous owner already given this record
+    for (int d = 0; d < 7; d++) {
+        if (!(day_mask & (1 << d))) continue;
+        for (int h = hour; h < hour + hours && h < 24; h++) {
+            SlotAction *slot = &slot_history[room_index][d][h];
+            if (slot->action == 'B' && slot->user >= 0) {
+                drop_active_slot(slot->user, slot->active_pos);
+                if (action == 'C' && slot->user != user_index && slot->user != told) {
+                    add_user_history(slot->user, record, true);
+                    told = slot->user;
+                }
+            }
+
+            slot->user = user_index;
+            slot->action = action;
+            if (action == 'B' && user_index >= 0) {
+                slot->active_pos = user_bookings[user_index].active_count;
+                if (!add_active_slot(user_index, slot_key(room_index, d, h))) slot->active_pos = -1;
+            }
+        }
+    }
+}
+
+void reset_replay_state() {
+    memset(slot_history, 0, (size_t)room_count * sizeof(*slot_history));
+    reset_user_bookings();
+    reset_calendar();
+    for (int i = 0; i < room_count; i++) room_intervals[i].count = 0;
+    log_record_count = 0;
+    log_block_count = 0;
+    memset(&log_tally, 0, sizeof(log_tally));
+}
+
+void replay_log_record(const BookingLogRecord *rec, long record) {
+    int user = log_user(rec->user_id);
+    if (rec->flags & LOG_FLAG_QUARTERS) {
+        record_interval_action(rec->room_id, rec->week, rec->day_mask, rec->hour * 15,
+                               (rec->hour + rec->hours) * 15, user, rec->action, record);
+    } else if (rec->week > 0) {
+        record_dated_action(rec->room_id, rec->week, rec->day, rec->hour, rec->hours, user,
+                            rec->action, record);
+    } else {
+        record_range_action(rec->room_id, rec->day_mask, rec->hour, rec->hours, user, rec->action,
+                            record);
+    }
+}
+
+// Streams bookings.dat once at startup, rebuilding slot_history and the
+// time index; afterwards appends keep both current
+bool build_slot_history_index() {
+    reset_replay_state();
+
+    // Large logs are mapped and replayed on several threads
+    int workers = worker_threads > 0 ? worker_threads : cpu_count();
+    if (workers > MAX_WORKER_THREADS) workers = MAX_WORKER_THREADS;
+    if (workers > 1) {
+        if (booking_log_fp) fflush(booking_log_fp);
+        MappedFile log;
+        if (map_file(&log, BOOKINGS_FILE)) {
+            long total = mapped_log_records(&log);
+            bool done = total >= REPLAY_PARALLEL_MIN && replay_log_in_parallel(&log, total, workers);
+            unmap_file(&log);
+            if (done) return true;
+            reset_replay_state(); // out of memory part way: start over on one thread
+        }
+    }
+
+    BookingLogReader reader;
+    if (!open_log_reader(&reader, 0)) return false;
+
+    // Skipped (corrupt) records still occupy a record number
+    const BookingLogRecord *rec;
+    long seen = 0;
+    while ((rec = next_raw_log_record(&reader)) != NULL) {
+        while (seen < reader.next - 1) {
+            index_log_record(log_max_time);
+            seen++;
+        }
+        index_log_record(rec->timestamp);
+        seen++;
+        replay_log_record(rec, reader.next - 1);
+        if (!(rec->flags & LOG_FLAG_SNAPSHOT)) {
+            tally_log_record(&log_tally, rec->action, rec->day_mask, rec->hour, rec->hours, rec->flags);
+        }
+    }
+    while (seen < reader.end) {
+        index_log_record(log_max_time);
+        seen++;
+    }
+    close_log_reader(&reader);
+    return true;
+}
+
+// Parallel Replay
+// A big bookings.dat is mapped and replayed in three steps:
+//  1. the log is cut into one chunk per thread at record boundaries, and
+//     each thread validates its records and resolves their room ids;
+//  2. each thread replays the weekly records of its own stripe of rooms in
+//     log order, so slot_history rows are never shared, and notes which
+//     earlier owners each cancellation displaced;
+//  3. one pass in log order merges those notes into the per-user lists,
+//     extends the time index and applies dated and sub-hour records, whose
+//     calendar tables are shared between rooms.
+// The result is the same as the serial replay above.
+
+#define REPLAY_UNKNOWN_ROOM (-1) // valid record for a room that no longer exists
+#define REPLAY_INVALID      (-2) // torn or corrupt record
+
+int cpu_count() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+typedef struct {
+    WorkerTask task;
+    void *arg;
+} WorkerStart;
+
+#ifdef _WIN32
+DWORD WINAPI worker_thread(LPVOID param) {
+    WorkerStart *start = param;
+    start->task(start->arg);
+    return 0;
+}
+#else
+void *worker_thread(void *param) {
+    WorkerStart *start = param;
+    start->task(start->arg);
+    return NULL;
+}
+#endif
+
+// Runs task on each of `count` argument blocks, one thread each, and waits
+// for all of them. A block that cannot get a thread runs on the caller's.
+void run_in_parallel(WorkerTask task, void *args, size_t arg_size, int count) {
+    WorkerStart starts[MAX_WORKER_THREADS];
+    bool started[MAX_WORKER_THREADS];
+#ifdef _WIN32
+    HANDLE threads[MAX_WORKER_THREADS];
+#else
+    pthread_t threads[MAX_WORKER_THREADS];
+#endif
+    if (count > MAX_WORKER_THREADS) count = MAX_WORKER_THREADS;
+
+    for (int i = 0; i < count; i++) {
+        starts[i].task = task;
+        starts[i].arg = (char *)args + (size_t)i * arg_size;
+#ifdef _WIN32
+        threads[i] = CreateThread(NULL, 0, worker_thread, &starts[i], 0, NULL);
+        started[i] = threads[i] != NULL;
+#else
+        started[i] = pthread_create(&threads[i], NULL, worker_thread, &starts[i]) == 0;
+#endif
+        if (!started[i]) task(starts[i].arg);
+    }
+    for (int i = 0; i < count; i++) {
+        if (!started[i]) continue;
+#ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+#else
+        pthread_join(threads[i], NULL);
+#endif
+    }
+}
+
+// Whole records in a mapped bookings.dat, or -1 if the header does not match
+long mapped_log_records(const MappedFile *log) {
+    const BookingsFileHeader *header = (const BookingsFileHeader *)log->data;
+    if (log->size < sizeof(*header) ||
+        memcmp(header->magic, BOOKINGS_DB_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != BOOKINGS_DB_VERSION ||
+        header->record_size != sizeof(BookingLogRecord)) {
+        return -1;
+    }
+    return (long)((log->size - sizeof(*header)) / sizeof(BookingLogRecord));
+}
+
+// Step 1: room lookups only read the room index, so chunks run side by side
+void resolve_replay_chunk(void *arg) {
+    ReplayWorker *worker = arg;
+    for (long r = worker->first; r < worker->end; r++) {
+        const BookingLogRecord *rec = &worker->records[r];
+        if (!log_record_valid(rec)) {
+            worker->room_of[r] = REPLAY_INVALID;
+            continue;
+        }
+        int room_index = find_room_by_id(rec->room_id);
+        worker->room_of[r] = room_index >= 0 ? room_index : REPLAY_UNKNOWN_ROOM;
+    }
+}
+
+// Step 2: record_range_action without the per-user lists, for one stripe
+void replay_room_stripe(void *arg) {
+    ReplayWorker *worker = arg;
+    for (long r = 0; r < worker->total && !worker->failed; r++) {
+        int room_index = worker->room_of[r];
+        if (room_index < 0 || room_index % worker->stripes != worker->stripe) continue;
+        const BookingLogRecord *rec = &worker->records[r];
+        if ((rec->flags & LOG_FLAG_QUARTERS) || rec->week > 0) continue; // step 3
+
+        int user = log_user(rec->user_id);
+        int told = -1; // previous owner already given this record
+        for (int d = 0; d < 7; d++) {
+            if (!(rec->day_mask & (1 << d))) continue;
+            for (int h = rec->hour; h < rec->hour + rec->hours && h < 24; h++) {
+                SlotAction *slot = &slot_history[room_index][d][h];
+                if (rec->action == 'C' && slot->action == 'B' && slot->user >= 0 &&
+                    slot->user != user && slot->user != told) {
+                    if (!grow_array((void **)&worker->notices, &worker->notice_capacity,
+                                    worker->notice_count + 1, sizeof(*worker->notices))) {
+                        worker->failed = true;
+                        return;
+                    }
+                    worker->notices[worker->notice_count].record = r;
+                    worker->notices[worker->notice_count].user = slot->user;
+                    worker->notice_count++;
+                    told = slot->user;
+                }
+                slot->user = user;
+                slot->action = rec->action;
+            }
+        }
+    }
+}
+
+bool replay_log_in_parallel(const MappedFile *log, long total, int workers) {
+    const BookingLogRecord *records =
+        (const BookingLogRecord *)(log->data + sizeof(BookingsFileHeader));
+    int *room_of = malloc((size_t)total * sizeof(int));
+    ReplayWorker *pool = calloc((size_t)workers, sizeof(ReplayWorker));
+    if (!room_of || !pool) {
+        free(room_of);
+        free(pool);
+        return false;
+    }
+
+    long chunk = (total + workers - 1) / workers;
+    for (int i = 0; i < workers; i++) {
+        pool[i].records = records;
+        pool[i].room_of = room_of;
+        pool[i].total = total;
+        pool[i].first = (long)i * chunk < total ? (long)i * chunk : total;
+        pool[i].end = pool[i].first + chunk < total ? pool[i].first + chunk : total;
+        pool[i].stripe = i;
+        pool[i].stripes = workers;
+    }
+    run_in_parallel(resolve_replay_chunk, pool, sizeof(*pool), workers);
+    run_in_parallel(replay_room_stripe, pool, sizeof(*pool), workers);
+
+    bool ok = true;
+    for (int i = 0; i < workers; i++) {
+        if (pool[i].failed) ok = false;
+    }
+
+    // Step 3: everything that is shared, in log order
+    int next_notice[MAX_WORKER_THREADS] = {0};
+    for (long r = 0; ok && r < total; r++) {
+        int room_index = room_of[r];
+        const BookingLogRecord *rec = &records[r];
+        if (!index_log_record(room_index == REPLAY_INVALID ? log_max_time : rec->timestamp)) {
+            ok = false;
+        }
+        if (room_index != REPLAY_INVALID && !(rec->flags & LOG_FLAG_SNAPSHOT)) {
+            tally_log_record(&log_tally, rec->action, rec->day_mask, rec->hour, rec->hours, rec->flags);
+        }
+        if (room_index < 0) continue;
+
+        if ((rec->flags & LOG_FLAG_QUARTERS) || rec->week > 0) {
+            replay_log_record(rec, r);
+            continue;
+        }
+        int user = log_user(rec->user_id);
+        if (user >= 0) add_user_history(user, r, false);
+
+        ReplayWorker *owner = &pool[room_index % workers];
+        int *next = &next_notice[room_index % workers];
+        while (*next < owner->notice_count && owner->notices[*next].record == r) {
+            add_user_history(owner->notices[(*next)++].user, r, true);
+        }
+    }
+
+    // Held slots, rebuilt from the final owners
+    for (int i = 0; ok && i < room_count; i++) {
+        for (int d = 0; d < 7; d++) {
+            for (int h = 0; h < 24; h++) {
+                SlotAction *slot = &slot_history[i][d][h];
+                if (slot->action != 'B' || slot->user < 0) continue;
+                slot->active_pos = user_bookings[slot->user].active_count;
+                if (!add_active_slot(slot->user, slot_key(i, d, h))) slot->active_pos = -1;
+            }
+        }
+    }
+
+    for (int i = 0; i < workers; i++) free(pool[i].notices);
+    free(pool);
+    free(room_of);
+    return ok;
+}
+
+// Random access by record number; reuses the buffered batch when it covers `record`
+bool read_log_record_at(BookingLogReader *reader, long record, BookingRecord *out) {
+    long first = reader->next - reader->pos; // record number of buf[0]
+    if (record >= first && record < first + reader->count) {
+        reader->pos = (int)(record - first);
+        reader->next = record;
+    } else {
+        if (record < 0 || record >= reader->end ||
+            fseek(reader->fp, booking_record_offset(record), SEEK_SET) != 0) {
+            return false;
+        }
+        reader->count = 0;
+        reader->pos = 0;
+        reader->next = record;
+    }
+    return next_log_record(reader, out) && reader->next == record + 1;
+}
+
+// Per-User Booking Index
+// Every user keeps the slots they currently hold and the record numbers of
+// the log entries that concern them, so "My Bookings" is proportional to
+// that user's own activity. Each held slot remembers its position in the
+// active list, so losing it is an O(1) swap-remove. Sub-hour bookings live
+// in the rooms' interval lists; users only note which rooms to look in.
+
+int slot_key(int room_index, int day, int hour) {
+    return (room_index * 7 + day) * 24 + hour;
+}
+
+bool add_active_slot(int user_index, int key) {
+    UserBookings *mine = &user_bookings[user_index];
+    if (!grow_array((void **)&mine->active, &mine->active_capacity,
+                    mine->active_count + 1, sizeof(*mine->active))) {
+        return false;
+    }
+    mine->active[mine->active_count++] = key;
+    return true;
+}
+
+void drop_active_slot(int user_index, int pos) {
+    UserBookings *mine = &user_bookings[user_index];
+    if (pos < 0 || pos >= mine->active_count) return;
+
+    int last = mine->active[--mine->active_count];
+    if (pos < mine->active_count) {
+        mine->active[pos] = last;
+        slot_history[last / (7 * 24)][(last / 24) % 7][last % 24].active_pos = pos;
+    }
+}
+
+bool add_user_history(int user_index, long record, bool by_other) {
+    UserBookings *mine = &user_bookings[user_index];
+    if (!grow_array((void **)&mine->history, &mine->history_capacity,
+                    mine->history_count + 1, sizeof(*mine->history))) {
+        return false;
+    }
+    mine->history[mine->history_count].record = record;
+    mine->history[mine->history_count].by_other = by_other;
+    mine->history_count++;
+    return true;
+}
+
+// Rooms stay listed after their bookings end; the lookup just finds none
+bool add_interval_room(int user_index, int room_index) {
+    UserBookings *mine = &user_bookings[user_index];
+    int pos = mine->interval_room_count;
+    while (pos > 0 && mine->interval_rooms[pos - 1] >= room_index) {
+        if (mine->interval_rooms[pos - 1] == room_index) return true;
+        pos--;
+    }
+    if (!grow_array((void **)&mine->interval_rooms, &mine->interval_room_capacity,
+                    mine->interval_room_count + 1, sizeof(*mine->interval_rooms))) {
+        return false;
+    }
+    memmove(mine->interval_rooms + pos + 1, mine->interval_rooms + pos,
+            (size_t)(mine->interval_room_count - pos) * sizeof(*mine->interval_rooms));
+    mine->interval_rooms[pos] = room_index;
+    mine->interval_room_count++;
+    return true;
+}
+
+void reset_user_bookings() {
+    for (int i = 0; i < user_capacity; i++) {
+        user_bookings[i].active_count = 0;
+        user_bookings[i].history_count = 0;
+        user_bookings[i].interval_room_count = 0;
+    }
+}
+
+int compare_ints(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Log Compaction
+// Compaction moves every event in bookings.dat into a new archive segment
+// and restarts the log with one LOG_FLAG_SNAPSHOT record per run of slots
+// a user still holds, so startup and history readers only see live state.
+// Segments are never rewritten; they are read only when a history view
+// asks for them. Records are stored as zigzag varint deltas from the
+// previous record (time, room, user) plus one varint of packed slot
+// fields, usually 6-8 bytes instead of 24.
+
+void archive_path(int segment, char *out, size_t size) {
+    snprintf(out, size, "%s.%03d.arc", BOOKINGS_ARCHIVE_PREFIX, segment);
+}
+
+// Also sums the segments' counters into archive_tally
+int count_archive_segments() {
+    char path[FILENAME_MAX];
+    int segments = 0;
+    memset(&archive_tally, 0, sizeof(archive_tally));
+    for (;;) {
+        archive_path(segments + 1, path, sizeof(path));
+        if (!file_exists(path)) break;
+        segments++;
+        if (!add_archive_tally(segments, &archive_tally)) {
+            fprintf(stderr, "Warning: archive segment %d is unreadable; stats leave it out\n", segments);
+        }
+    }
+    archive_segments = segments;
+    return segments;
+}
+
+// Adds one segment's counters: read from a version 2 header, or counted by
+// decoding a version 1 segment, which predates them
+bool add_archive_tally(int segment, LogTally *tally) {
+    char path[FILENAME_MAX];
+    archive_path(segment, path, sizeof(path));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return false;
+
+    ArchiveHeader header;
+    LogTally stored;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+              memcmp(header.magic, ARCHIVE_MAGIC, sizeof(header.magic)) == 0;
+    bool has_tally = ok && header.version == ARCHIVE_VERSION;
+    if (has_tally) ok = fread(&stored, sizeof(stored), 1, fp) == 1;
+    fclose(fp);
+    if (!ok) return false;
+
+    if (has_tally) {
+        for (int d = 0; d < 7; d++) {
+            for (int h = 0; h < 24; h++) {
+                tally->booked[d][h] += stored.booked[d][h];
+                tally->cancelled[d][h] += stored.cancelled[d][h];
+            }
+        }
+        tally->records += stored.records;
+        return true;
+    }
+
+    ArchiveCursor cursor;
+    uint8_t *data = load_archive_segment(segment, &header, &cursor);
+    if (!data) return false;
+    BookingRecord rec;
+    while (next_archive_record(&cursor, &rec)) {
+        tally_log_record(tally, rec.action, rec.day_mask, rec.hour, rec.hours, rec.flags);
+    }
+    free(data);
+    return true;
+}
+
+size_t put_varint(uint8_t *out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+bool get_varint(ArchiveCursor *cursor, uint64_t *value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && cursor->p < cursor->end; shift += 7) {
+        uint8_t byte = *cursor->p++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+#define ZIGZAG(v)   (((uint64_t)(v) << 1) ^ (uint64_t)((int64_t)(v) >> 63))
+#define UNZIGZAG(u) ((int64_t)((u) >> 1) ^ -(int64_t)((u) & 1))
+
+// Event records at the head of bookings.dat that the newest segment already
+// holds. A crash after a segment is written but before the log is replaced
+// leaves them there, and the next compaction must not archive them twice.
+long archived_log_prefix() {
+    if (archive_segments == 0) return 0;
+
+    ArchiveHeader header;
+    ArchiveCursor cursor;
+    uint8_t *data = load_archive_segment(archive_segments, &header, &cursor);
+    if (!data) return 0;
+    BookingLogReader reader;
+    if (!open_log_reader(&reader, 0)) {
+        free(data);
+        return 0;
+    }
+
+    long matched = 0;
+    BookingRecord archived, logged;
+    while (next_archive_record(&cursor, &archived)) {
+        bool found;
+        while ((found = next_log_record(&reader, &logged)) && (logged.flags & LOG_FLAG_SNAPSHOT));
+        if (!found || !records_equal(&archived, &logged)) break;
+        matched++;
+    }
+    close_log_reader(&reader);
+    free(data);
+    return matched == (long)header.record_count ? matched : 0;
+}
+
+// Encodes the event records of bookings.dat after the first `skip` into
+// `path`; returns the count or -1
+long write_archive_segment(const char *path, long skip) {
+    BookingLogReader reader;
+    if (!open_log_reader(&reader, 0)) return -1;
+
+    FILE *fp = fopen(path, "wb");
+    uint8_t *buf = malloc(ARCHIVE_BUFFER_SIZE);
+    if (!fp || !buf) {
+        if (fp) fclose(fp);
+        free(buf);
+        close_log_reader(&reader);
+        return -1;
+    }
+
+    ArchiveHeader header = {0};
+    LogTally tally = {0};
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version = ARCHIVE_VERSION;
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(&tally, sizeof(tally), 1, fp) == 1;
+
+    size_t used = 0;
+    int64_t prev_time = 0, prev_room = 0, prev_user = 0;
+    BookingRecord rec;
+    while (ok && next_log_record(&reader, &rec)) {
+        // Snapshots restate history that an earlier segment already holds
+        if (rec.flags & LOG_FLAG_SNAPSHOT) continue;
+        if (skip > 0) {
+            skip--;
+            continue;
+        }
+
+        if (header.record_count == 0) header.first_time = rec.timestamp;
+        header.last_time = rec.timestamp;
+        header.record_count++;
+        tally_log_record(&tally, rec.action, rec.day_mask, rec.hour, rec.hours, rec.flags);
+
+        // Quarter-hour records need two more bits for hour and hours, kept
+        // above the week so older segments decode unchanged
+        uint64_t packed = (uint64_t)rec.day | (uint64_t)(rec.hour & 0x1F) << 3 |
+                          (uint64_t)(rec.hours & 0x1F) << 8 | (uint64_t)rec.day_mask << 13 |
+                          (uint64_t)(rec.action == 'C') << 20 | (uint64_t)rec.flags << 21 |
+                          (uint64_t)rec.week << 29 | (uint64_t)(rec.hour >> 5) << 45 |
+                          (uint64_t)(rec.hours >> 5) << 47;
+        used += put_varint(buf + used, ZIGZAG(rec.timestamp - prev_time));
+        used += put_varint(buf + used, ZIGZAG((int64_t)rec.room_id - prev_room));
+        used += put_varint(buf + used, ZIGZAG((int64_t)rec.user - prev_user));
+        used += put_varint(buf + used, packed);
+        prev_time = rec.timestamp;
+        prev_room = rec.room_id;
+        prev_user = rec.user;
+
+        // Four varints never exceed 40 bytes
+        if (used > ARCHIVE_BUFFER_SIZE - 64) {
+            ok = fwrite(buf, 1, used, fp) == used;
+            used = 0;
+        }
+    }
+    close_log_reader(&reader);
+
+    if (ok && used > 0) ok = fwrite(buf, 1, used, fp) == used;
+    if (ok) {
+        ok = fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(&tally, sizeof(tally), 1, fp) == 1;
+    }
+    if (ok) ok = fflush(fp) == 0 && sync_file(fp);
+    if (fclose(fp) != 0) ok = false;
+    free(buf);
+
+    if (!ok) {
+        remove(path);
+        return -1;
+    }
+    return (long)header.record_count;
+}
+
+bool write_interval_snapshot(FILE *fp, int room_id, int week, const IntervalIndex *index, long *kept) {
+    for (int i = 0; i < index->count; i++) {
+        const Interval *it = &index->items[i];
+        int day = it->start / MINUTES_PER_DAY;
+
+        BookingLogRecord rec = {0};
+        rec.room_id = room_id;
+        rec.user_id = it->user;
+        rec.day = (uint8_t)day;
+        rec.hour = (uint8_t)((it->start - day * MINUTES_PER_DAY) / 15);
+        rec.hours = (uint8_t)((it->end - it->start) / 15);
+        rec.day_mask = (uint8_t)(1 << day);
+        rec.action = 'B';
+        rec.flags = LOG_FLAG_SNAPSHOT | LOG_FLAG_QUARTERS;
+        rec.week = (uint16_t)week;
+        if (fwrite(&rec, sizeof(rec), 1, fp) != 1) return false;
+        (*kept)++;
+    }
+    return true;
+}
+
+// Writes a fresh log holding only the current owners, one record per run
+bool write_log_snapshot(const char *path, long *kept) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return false;
+
+    BookingsFileHeader header = {0};
+    memcpy(header.magic, BOOKINGS_DB_MAGIC, sizeof(header.magic));
+    header.version = BOOKINGS_DB_VERSION;
+    header.record_size = sizeof(BookingLogRecord);
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    *kept = 0;
+    for (int i = 0; ok && i < room_count; i++) {
+        for (int d = 0; ok && d < 7; d++) {
+            for (int h = 0; ok && h < 24; ) {
+                const SlotAction *slot = &slot_history[i][d][h];
+                if (slot->action != 'B' || !slot_is_booked(&rooms[i], d, h)) {
+                    h++;
+                    continue;
+                }
+
+                int end = h + 1;
+                while (end < 24 && slot_history[i][d][end].action == 'B' &&
+                       slot_history[i][d][end].user == slot->user &&
+                       slot_is_booked(&rooms[i], d, end)) {
+                    end++;
+                }
+
+                BookingLogRecord rec = {0};
+                rec.room_id = rooms[i].id;
+                rec.user_id = slot->user;
+                rec.day = (uint8_t)d;
+                rec.hour = (uint8_t)h;
+                rec.hours = (uint8_t)(end - h);
+                rec.day_mask = (uint8_t)(1 << d);
+                rec.action = 'B';
+                rec.flags = LOG_FLAG_SNAPSHOT;
+                ok = fwrite(&rec, sizeof(rec), 1, fp) == 1;
+                (*kept)++;
+                h = end;
+            }
+        }
+    }
+
+    // Sub-hour bookings, one record each; dated ones are written with their week below
+    for (int i = 0; ok && i < room_count; i++) {
+        ok = write_interval_snapshot(fp, rooms[i].id, 0, &room_intervals[i], kept);
+    }
+
+    // Dated bookings still in memory, with the same run-per-owner layout
+    for (int k = 0; ok && k < calendar_week_count; k++) {
+        const CalendarWeek *cw = calendar_weeks[k];
+        ok = write_interval_snapshot(fp, rooms[cw->room_index].id, cw->week, &cw->intervals, kept);
+        for (int d = 0; ok && d < 7; d++) {
+            for (int h = 0; ok && h < 24; ) {
+                if (!(cw->schedule[d] & (1u << h))) {
+                    h++;
+                    continue;
+                }
+
+                int user = calendar_owner(cw, d, h);
+                int end = h + 1;
+                while (end < 24 && (cw->schedule[d] & (1u << end)) && calendar_owner(cw, d, end) == user) {
+                    end++;
+                }
+
+                BookingLogRecord rec = {0};
+                rec.room_id = rooms[cw->room_index].id;
+                rec.user_id = user;
+                rec.day = (uint8_t)d;
+                rec.hour = (uint8_t)h;
+                rec.hours = (uint8_t)(end - h);
+                rec.day_mask = (uint8_t)(1 << d);
+                rec.action = 'B';
+                rec.flags = LOG_FLAG_SNAPSHOT;
+                rec.week = (uint16_t)cw->week;
+                ok = fwrite(&rec, sizeof(rec), 1, fp) == 1;
+                (*kept)++;
+                h = end;
+            }
+        }
+    }
+
+    if (ok) ok = fflush(fp) == 0 && sync_file(fp);
+    if (fclose(fp) != 0) ok = false;
+    if (!ok) remove(path);
+    return ok;
+}
+
+// Archives the whole log, then swaps in the snapshot. A crash before the
+// rename leaves the old log in place; the next compaction archives it again.
+bool compact_booking_log(long *archived, long *kept) {
+    if (serving) return false;
+    if (archive_segments == 0) count_archive_segments();
+
+    char segment_path[FILENAME_MAX], snapshot_path[FILENAME_MAX];
+    archive_path(archive_segments + 1, segment_path, sizeof(segment_path));
+    snprintf(snapshot_path, sizeof(snapshot_path), "%s.tmp", BOOKINGS_FILE);
+
+    if ((*archived = write_archive_segment(segment_path, archived_log_prefix())) < 0) return false;
+    if (*archived == 0) remove(segment_path);
+
+    // Ended weeks go to calendar.dat first so the snapshot can leave them out;
+    // if that fails they simply stay in the snapshot
+    evict_past_weeks();
+    if (!write_log_snapshot(snapshot_path, kept)) return false;
+
+    close_booking_log();
+    if (!replace_file(snapshot_path, BOOKINGS_FILE)) {
+        remove(snapshot_path);
+        open_booking_log();
+        return false;
+    }
+    if (*archived > 0 && add_archive_tally(archive_segments + 1, &archive_tally)) {
+        archive_segments++;
+    } else if (*archived > 0) {
+        count_archive_segments(); // recount rather than leave the stats short
+    }
+
+    bool ok = open_booking_log();
+    build_slot_history_index();
+    return ok;
+}
+
+// Reads a whole segment into memory; the caller frees the returned buffer
+uint8_t *load_archive_segment(int segment, ArchiveHeader *header, ArchiveCursor *cursor) {
+    char path[FILENAME_MAX];
+    archive_path(segment, path, sizeof(path));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return NULL;
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp) - (long)sizeof(*header);
+    rewind(fp);
+
+    // Version 1 segments have no LogTally before the records
+    uint8_t *data = NULL;
+    if (size >= 0 &&
+        fread(header, sizeof(*header), 1, fp) == 1 &&
+        memcmp(header->magic, ARCHIVE_MAGIC, sizeof(header->magic)) == 0 &&
+        (header->version == 1 ||
+         (header->version == ARCHIVE_VERSION && (size -= (long)sizeof(LogTally)) >= 0 &&
+          fseek(fp, (long)sizeof(LogTally), SEEK_CUR) == 0)) &&
+        (data = malloc((size_t)size + 1)) != NULL &&
+        fread(data, 1, (size_t)size, fp) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    if (!data) return NULL;
+
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->p = data;
+    cursor->end = data + size;
+    cursor->left = header->record_count;
+    return data;
+}
+
+bool next_archive_record(ArchiveCursor *cursor, BookingRecord *out) {
+    uint64_t dt, droom, duser, packed;
+    if (cursor->left == 0 ||
+        !get_varint(cursor, &dt) || !get_varint(cursor, &droom) ||
+        !get_varint(cursor, &duser) || !get_varint(cursor, &packed)) {
+        return false;
+    }
+    cursor->left--;
+    cursor->timestamp += UNZIGZAG(dt);
+    cursor->room_id += UNZIGZAG(droom);
+    cursor->user_id += UNZIGZAG(duser);
+
+    out->timestamp = cursor->timestamp;
+    out->room_id = (int)cursor->room_id;
+    out->day = (int)(packed & 0x7);
+    out->hour = (int)((packed >> 3) & 0x1F) | (int)((packed >> 45) & 0x3) << 5;
+    out->hours = (int)((packed >> 8) & 0x1F) | (int)((packed >> 47) & 0x3) << 5;
+    out->day_mask = (int)((packed >> 13) & 0x7F);
+    out->action = (packed >> 20) & 1 ? 'C' : 'B';
+    out->flags = (int)((packed >> 21) & 0xFF);
+    out->week = (int)((packed >> 29) & 0xFFFF); // 0 in segments written before dated bookings
+    out->user = log_user(cursor->user_id);
+    strcpy(out->username, user_display_name(out->user));
+    return true;
+}
+
+// All archived records, or only those written by `user_index` (-1 for all)
+bool records_equal(const BookingRecord *a, const BookingRecord *b) {
+    return a->timestamp == b->timestamp && a->room_id == b->room_id && a->user == b->user &&
+           a->day == b->day && a->hour == b->hour && a->hours == b->hours &&
+           a->day_mask == b->day_mask && a->action == b->action && a->flags == b->flags &&
+           a->week == b->week;
+}
+
+// Applies one archived record to the viewer's bookings. True when it is
+// someone else cancelling one of them, as add_user_history(..., true) does
+// for the live log.
+bool track_archived_span(ArchivedSpan **spans, int *count, int *capacity,
+                         const BookingRecord *rec, int user_index) {
+    int start, end;
+    record_minutes(rec->hour, rec->hours, rec->flags, &start, &end);
+    if (end <= start) end = start + 1;
+
+    bool displaced = false;
+    for (int d = 0; d < 7; d++) {
+        if (!(rec->day_mask & (1 << d))) continue;
+        for (int i = 0; i < *count;) {
+            ArchivedSpan *span = &(*spans)[i];
+            if (span->room_id != rec->room_id || span->week != rec->week || span->day != d ||
+                span->end <= start || end <= span->start) {
+                i++;
+                continue;
+            }
+            if (rec->action == 'C' && rec->user != user_index) displaced = true;
+            *span = (*spans)[--*count]; // booked over or cancelled: no longer the viewer's
+        }
+        if (rec->action == 'B' && rec->user == user_index &&
+            grow_array((void **)spans, capacity, *count + 1, sizeof(**spans))) {
+            (*spans)[(*count)++] = (ArchivedSpan){rec->room_id, rec->week, d, start, end};
+        }
+    }
+    return displaced;
+}
+
+void print_archived_history(Screen *out, int user_index) {
+    ArchivedSpan *spans = NULL;
+    int span_count = 0, span_capacity = 0;
+
+    for (int segment = 1; segment <= archive_segments; segment++) {
+        ArchiveHeader header;
+        ArchiveCursor cursor;
+        uint8_t *data = load_archive_segment(segment, &header, &cursor);
+        if (!data) {
+            screen_color(out, 12); // Red
+            screen_printf(out, "\t\t\t\t\tCould not read archive segment %d.\n", segment);
+            screen_color(out, 7); // Reset
+            continue;
+        }
+
+        char from[16] = "unknown", to[16] = "unknown";
+        time_t first = (time_t)header.first_time, last = (time_t)header.last_time;
+        if (header.first_time > 0) strftime(from, sizeof(from), "%Y-%m-%d", localtime(&first));
+        if (header.last_time > 0) strftime(to, sizeof(to), "%Y-%m-%d", localtime(&last));
+
+        screen_color(out, 14); // Yellow
+        screen_printf(out, "\n\t\t\t\t\tArchive %d (%s to %s, %u records)\n",
+                segment, from, to, header.record_count);
+        screen_color(out, 7); // Reset
+
+        BookingRecord rec;
+        while (next_archive_record(&cursor, &rec)) {
+            if (user_index != -1 &&
+                !track_archived_span(&spans, &span_count, &span_capacity, &rec, user_index) &&
+                rec.user != user_index) {
+                continue;
+            }
+
+            char when[80];
+            format_record_when(&rec, when, sizeof(when));
+            if (rec.action == 'B') {
+                screen_color(out, 10); // Green
+                screen_printf(out, "\t\t\t\t\t[BOOKED] ");
+            } else {
+                screen_color(out, 12); // Red
+                screen_printf(out, "\t\t\t\t\t[CANCELLED] ");
+            }
+            screen_printf(out, "Room %d | %s | by %s\n", rec.room_id, when, rec.username);
+            screen_color(out, 7); // Reset
+        }
+        free(data);
+    }
+    free(spans);
+}
+
+// History screens only touch the archives when the user asks for them
+void offer_archived_history(int user_index) {
+    if (archive_segments == 0) return;
+
+    printf("\n\t\t\t\t\tOlder history is archived in %d segment(s). Show it? (Y/N): ",
+           archive_segments);
+    char confirm;
+    if (scanf(" %c", &confirm) != 1) return;
+    while (getchar() != '\n');
+
+    if (toupper(confirm) == 'Y') {
+        Screen screen;
+        screen_open(&screen, stdout);
+        print_archived_history(&screen, user_index);
+        screen_flush(&screen, stdout, true);
+        screen_close(&screen);
+    }
+}
+
+void compact_history() {
+    if (current_user_index == -1 || !users[current_user_index].is_admin) {
+        printf("\t\t\t\t\tOnly admins can compact the booking log.\n");
+        pause_and_clear();
+        return;
+    }
+
+    long archived = 0, kept = 0;
+    if (compact_booking_log(&archived, &kept)) {
+        set_text_color(10); // Green
+        printf("\t\t\t\t\tArchived %ld records; the log now holds %ld current bookings.\n",
+               archived, kept);
+        set_text_color(7); // Reset
+    } else {
+        printf("\t\t\t\t\tError: Failed to compact the booking log!\n");
+    }
+    pause_and_clear();
+}
+
+bool get_last_slot_action(int room_id, int day, int hour, char *out_username, char *out_action, bool *found) {
+    *found = false;
+    int room_index = find_room_by_id(room_id);
+    if (room_index == -1) return true;
+    return get_last_slot_action_at(room_index, day, hour, out_username, out_action, found);
+}
+
+bool get_last_slot_action_at(int room_index, int day, int hour, char *out_username, char *out_action, bool *found) {
+    *found = false;
+    if (day < 0 || day > 6 || hour < 0 || hour > 23) return true;
+
+    const SlotAction *last = &slot_history[room_index][day][hour];
+    if (last->action == 0) return true;
+
+    *found = true;
+    if (out_username) {
+        strcpy(out_username, user_display_name(last->user));
+    }
+    if (out_action) *out_action = last->action;
+    return true;
+}
+
+// Core Functions
+
+void initialize_sample_data() {
+    user_count = 0;
+    room_count = 0;
+    if (!reserve_users(2) || !reserve_rooms(69)) return;
+    memset(users, 0, (size_t)user_capacity * sizeof(*users));
+    memset(rooms, 0, (size_t)room_capacity * sizeof(*rooms));
+
+    strcpy(users[0].username, "admin");
+    // Stored as plaintext only if hashing fails; authenticate() upgrades it
+    if (!hash_password("admin123", password_iterations, users[0].password, sizeof(users[0].password))) {
+        strcpy(users[0].password, "admin123");
+    }
+    users[0].is_admin = true;
+
+    strcpy(users[1].username, "faculty");
+    if (!hash_password("faculty123", password_iterations, users[1].password, sizeof(users[1].password))) {
+        strcpy(users[1].password, "faculty123");
+    }
+    users[1].is_admin = false;
+    user_count = 2;
+    rebuild_user_index();
+
+    int idx = 0;
+    for (int i = 101; i <= 123; i++) {
+        rooms[idx].id = i;
+        strcpy(rooms[idx].department, "CSE");
+        strcpy(rooms[idx].type, "lab");
+        memset(rooms[idx].schedule, 0, sizeof(rooms[idx].schedule));
+        idx++;
+    }
+
+    for (int i = 201; i <= 223; i++) {
+        rooms[idx].id = i;
+        strcpy(rooms[idx].department, "EEE");
+        strcpy(rooms[idx].type, "general");
+        memset(rooms[idx].schedule, 0, sizeof(rooms[idx].schedule));
+        idx++;
+    }
+
+    for (int i = 301; i <= 323; i++) {
+        rooms[idx].id = i;
+        strcpy(rooms[idx].department, "CSE");
+        strcpy(rooms[idx].type, "lab");
+        memset(rooms[idx].schedule, 0, sizeof(rooms[idx].schedule));
+        idx++;
+    }
+    room_count = idx;
+    rebuild_room_index();
+    rebuild_room_groups();
+}
+
+void ensure_data_loaded_or_initialized() {
+    bool users_ok = file_exists(USERS_FILE) && load_users();
+    bool rooms_ok = load_rooms();
+
+    if (!users_ok || !rooms_ok) {
+        printf("\nInitializing sample data...\n");
+        initialize_sample_data();
+        if (!save_users()) {
+            printf("Warning: Failed to save initial users!\n");
+        }
+        if (!save_rooms()) {
+            printf("Warning: Failed to save initial rooms!\n");
+        }
+    }
+
+    // Fold in slot changes from a session that ended without a checkpoint
+    if (replay_rooms_wal() > 0 && !checkpoint_rooms()) {
+        printf("Warning: Failed to checkpoint recovered bookings!\n");
+    }
+    if (!open_rooms_wal()) {
+        printf("Warning: Failed to open booking journal!\n");
+    }
+
+    if (!load_history_names()) {
+        printf("Warning: Failed to load %s!\n", BOOKINGS_NAMES_FILE);
+    }
+    // Usernames resolve to user ids, so this runs after the users are loaded
+    if (!file_exists(BOOKINGS_FILE) && file_exists(BOOKINGS_TEXT_FILE) && !migrate_bookings_text()) {
+        printf("Warning: Failed to migrate %s!\n", BOOKINGS_TEXT_FILE);
+    }
+    if (!open_booking_log()) {
+        printf("Warning: Failed to open booking history!\n");
+    }
+
+    if (!load_calendar_header()) {
+        printf("Warning: %s is unreadable; dated bookings are kept in memory.\n", CALENDAR_FILE);
+    }
+    build_slot_history_index();
+    if (evict_past_weeks() < 0) {
+        printf("Warning: Failed to move past weeks to %s!\n", CALENDAR_FILE);
+    }
+
+    count_archive_segments();
+    if (log_record_count >= LOG_COMPACT_THRESHOLD) {
+        long archived, kept;
+        printf("Compacting booking history (%ld records)...\n", log_record_count);
+        if (!compact_booking_log(&archived, &kept)) {
+            printf("Warning: Failed to compact booking history!\n");
+        }
+    }
+}
+
+void register_user() {
+    if (!reserve_users(user_count + 1)) {
+        printf("\t\t\t\t\tOut of memory: cannot register more users.\n");
+        pause_and_clear();
+        return;
+    }
+
+    char uname[50], pass[50];
+    printf("\t\t\t\t\tEnter username: ");
+    scanf(" %49s", uname);
+    while (getchar() != '\n');
+
+    if (find_user_by_name(uname) != -1) {
+        printf("\t\t\t\t\tUsername already exists.\n");
+        pause_and_clear();
+        return;
+    }
+
+    printf("\t\t\t\t\tEnter password: ");
+    get_password(pass, sizeof(pass));
+
+    strncpy(users[user_count].username, uname, sizeof(users[user_count].username)-1);
+    users[user_count].username[sizeof(users[user_count].username)-1] = '\0';
+    if (!hash_password(pass, password_iterations, users[user_count].password,
+                       sizeof(users[user_count].password))) {
+        printf("\t\t\t\t\tCould not hash the password. Registration cancelled.\n");
+        pause_and_clear();
+        return;
+    }
+    users[user_count].is_admin = false;
+    user_count++;
+    index_user(user_count - 1);
+
+    if (!persist_users()) {
+        printf("\t\t\t\t\tWarning: failed to save users to file!\n");
+    } else {
+        printf("\t\t\t\t\tRegistration successful and saved.\n");
+    }
+    pause_and_clear();
+}
+
+bool login() {
+    char username[50], password[50];
+    printf("\t\t\t\t\tUsername: ");
+    scanf(" %49s", username);
+    while (getchar() != '\n');
+
+    printf("\t\t\t\t\tPassword: ");
+    get_password(password, sizeof(password));
+
+    int i = authenticate(username, password);
+    if (i != -1) {
+        current_user_index = i;
+        printf("\t\t\t\t\tLogin successful. Welcome %s!\n", username);
+        pause_and_clear();
+        return true;
+    }
+
+    printf("\t\t\t\t\tLogin failed. Invalid username or password.\n");
+    pause_and_clear();
+    return false;
+}
+
+// *week is set for a date and 0 for a weekday; *minute is from midnight
+void get_search_input(char *dept, int *week, int *day, int *minute, char *type) {
+    char dayInput[12];
+    char timeInput[20];
+
+    while (1) {
+        printf("\t\t\t\t\tDepartment (CSE/EEE/...): ");
+        if (scanf(" %19s", dept) != 1) {
+            while (getchar() != '\n');
+            continue;
+        }
+
+        printf("\t\t\t\t\tDay (Sun, Mon, Tue, Wed, Thu, Fri, Sat) or Date (YYYY-MM-DD): ");
+        if (scanf(" %11s", dayInput) != 1) {
+            while (getchar() != '\n');
+            continue;
+        }
+
+        *week = 0;
+        if (!parse_date(dayInput, week, day)) *day = validate_day(dayInput);
+        if (*day == -1) {
+            printf("\t\t\t\t\tInvalid day. Please try again.\n");
+            continue;
+        }
+
+        while (getchar() != '\n'); // clear input buffer
+
+        printf("\t\t\t\t\tTime (e.g., 9AM, 2PM, 9:30AM): ");
+        if (!fgets(timeInput, sizeof(timeInput), stdin)) {
+            continue;
+        }
+
+        timeInput[strcspn(timeInput, "\n")] = '\0'; // remove newline
+
+        if (!parse_time_input(timeInput, minute)) {
+            printf("\t\t\t\t\tInvalid time format. Please enter like '9AM' or '2:30PM'.\n");
+            continue;
+        }
+
+        printf("\t\t\t\t\tRoom Type (Lab/General): ");
+        if (scanf(" %9s", type) != 1) {
+            while (getchar() != '\n');
+            continue;
+        }
+
+        to_lower_case(type);
+        if (!validate_room_type(type)) {
+            printf("\t\t\t\t\tInvalid room type. Please enter 'Lab' or 'General'.\n");
+            continue;
+        }
+
+        break; // all inputs valid
+    }
+}
+
+
+void search_classrooms() {
+    char dept[20], type[10];
+    int week, day, minute;
+
+    get_search_input(dept, &week, &day, &minute, type);
+
+    char time_display[10], day_display[40];
+    minute_to_ampm(minute, time_display);
+    format_booking_days(week, 1 << day, day_display, sizeof(day_display));
+
+    // Dates that were moved to calendar.dat are read back at hour resolution
+    uint32_t *dated = NULL;
+    if (week > 0 && week < calendar_evicted_before) {
+        dated = malloc((size_t)room_count * sizeof(*dated) + sizeof(*dated));
+        if (dated && !dated_bits_for_day(week, day, dated)) {
+            printf("\t\t\t\t\tWarning: Could not read %s; dated bookings are not shown.\n",
+                   CALENDAR_FILE);
+            free(dated);
+            dated = NULL;
+        }
+    }
+
+    printf("\n\t\t\t\t\tAvailable rooms in %s department (%s):\n", dept, type);
+    printf("\t\t\t\t\tDay: %s, Time: %s\n", day_display, time_display);
+    printf("\t\t\t\t\t--------------------------------\n");
+
+    RoomGroup *group = find_room_group(lookup_name(&department_names, dept),
+                                       lookup_name(&room_type_names, type));
+    int matches = group ? group->count : 0;
+
+    // Weekly bookings for the whole campus in one pass; the group picks
+    // its rooms out of the set
+    uint64_t *free_set = alloc_room_set();
+    if (free_set) rooms_free_at(day, minute, free_set);
+
+    bool found = false;
+    for (int k = 0; k < matches; k++) {
+        int i = group->members[k];
+        int floor = rooms[i].id / 100;
+        set_text_color(6);
+        printf("\t\t\t\t\tRoom ID: %d (Floor %d) -> ", rooms[i].id, floor);
+
+        bool is_free = free_set ? room_set_contains(free_set, i) : room_free_at(i, 0, day, minute);
+        if (is_free && dated) {
+            is_free = !(dated[i] & (1u << (minute / 60)));
+        } else if (is_free && week > 0) {
+            is_free = room_dated_free_for(i, week, day, minute, minute + 1);
+        }
+        if (!is_free) {
+            set_text_color(12);
+            printf("BOOKED\n");
+        } else {
+            set_text_color(10);
+            printf("AVAILABLE\n");
+        }
+        set_text_color(7);
+        found = true;
+    }
+
+    if (!found) {
+        set_text_color(4);
+        printf("\t\t\t\t\tNo rooms found matching criteria.\n");
+    }
+    free(free_set);
+    free(dated);
+    pause_and_clear();
+}
+
+// Free-Window Finder
+// Answers "where can I get N hours in a row" in one pass per day: each
+// matching room's day word becomes a word of window start bits (see
+// free_window_starts()), and the hours are visited lowest bit first so
+// results come out earliest-first and the search stops at the limit.
+
+bool room_matches_query(int room_index, const WindowQuery *query) {
+    const Classroom *room = &rooms[room_index];
+    return (query->dept_id == -1 || room->dept_id == query->dept_id) &&
+           (query->type_id == -1 || room->type_id == query->type_id) &&
+           (query->floor == -1 || room->id / 100 == query->floor);
+}
+
+// Fills out[] ranked by day, then start hour, then room; returns the count
+int find_free_windows(const WindowQuery *query, FreeWindow *out, int limit) {
+    if (query->hours < 1 || query->hours > 24 || limit < 1) return 0;
+    if (query->dept_id == -1 && query->type_id == -1 && query->floor == -1) {
+        return find_campus_windows(query, out, limit);
+    }
+
+    // A department and type together already have a bucket
+    int *candidates = NULL;
+    int candidate_count = 0;
+    RoomGroup *group = NULL;
+    if (query->dept_id != -1 && query->type_id != -1) {
+        group = find_room_group(query->dept_id, query->type_id);
+        if (!group) return 0;
+    }
+
+    int pool = group ? group->count : room_count;
+    candidates = malloc(((size_t)pool + 1) * sizeof(int));
+    uint32_t *starts = malloc(((size_t)pool + 1) * sizeof(uint32_t));
+    if (!candidates || !starts) {
+        free(candidates);
+        free(starts);
+        return 0;
+    }
+    for (int k = 0; k < pool; k++) {
+        int i = group ? group->members[k] : k;
+        if (room_matches_query(i, query)) candidates[candidate_count++] = i;
+    }
+
+    int found = 0;
+    for (int d = 0; d < 7 && found < limit; d++) {
+        if (!(query->day_mask & (1 << d))) continue;
+
+        uint32_t any = 0;
+        for (int c = 0; c < candidate_count; c++) {
+            uint32_t busy = room_busy_hours(candidates[c], d);
+            uint32_t word = free_window_starts(busy, query->hours);
+            if (query->first_only) word &= -word; // keep the lowest bit
+            starts[c] = word;
+            any |= word;
+        }
+
+        while (any && found < limit) {
+            int h = lowest_bit(any);
+            any &= any - 1;
+            for (int c = 0; c < candidate_count && found < limit; c++) {
+                if (!((starts[c] >> h) & 1u)) continue;
+                out[found].room_index = candidates[c];
+                out[found].day = d;
+                out[found].hour = h;
+                found++;
+            }
+        }
+    }
+
+    free(candidates);
+    free(starts);
+    return found;
+}
+
+// No filters: one rooms_free_for() pass per start hour, so results come out
+// in rank order and a small limit is met after the first free hour
+int find_campus_windows(const WindowQuery *query, FreeWindow *out, int limit) {
+    uint64_t *free_set = alloc_room_set();
+    uint64_t *seen = alloc_room_set(); // first_only: rooms already reported today
+    if (!free_set || !seen) {
+        free(free_set);
+        free(seen);
+        return 0;
+    }
+
+    int words = ROOM_SET_WORDS(room_count);
+    int found = 0;
+    for (int d = 0; d < 7 && found < limit; d++) {
+        if (!(query->day_mask & (1 << d))) continue;
+        memset(seen, 0, (size_t)words * sizeof(uint64_t));
+
+        for (int h = 0; h + query->hours <= 24 && found < limit; h++) {
+            if (rooms_free_for(d, h, query->hours, free_set) == 0) continue;
+            for (int w = 0; w < words && found < limit; w++) {
+                uint64_t word = free_set[w];
+                if (query->first_only) {
+                    word &= ~seen[w];
+                    seen[w] |= word;
+                }
+                for (; word && found < limit; word &= word - 1) {
+                    out[found].room_index = w * 64 + lowest_bit64(word);
+                    out[found].day = d;
+                    out[found].hour = h;
+                    found++;
+                }
+            }
+        }
+    }
+
+    free(free_set);
+    free(seen);
+    return found;
+}
+
+// "*" leaves a filter open; an unknown department or type matches nothing
+bool parse_window_filters(const char *dept, const char *type, const char *floor, WindowQuery *query) {
+    query->dept_id = -1;
+    query->type_id = -1;
+    query->floor = -1;
+    if (strcmp(dept, "*") != 0 && (query->dept_id = lookup_name(&department_names, dept)) == -1) {
+        return false;
+    }
+    if (strcmp(type, "*") != 0 && (query->type_id = lookup_name(&room_type_names, type)) == -1) {
+        return false;
+    }
+    if (strcmp(floor, "*") != 0) {
+        char *end;
+        long value = strtol(floor, &end, 10);
+        if (*end != '\0' || value < 0) return false;
+        query->floor = (int)value;
+    }
+    return true;
+}
+
+void find_free_window() {
+    char dept[20], type[10], floor[10], day_input[40], mode[10];
+    WindowQuery query;
+    int limit;
+
+    printf("\t\t\t\t\tDepartment (CSE/EEE/..., * for any): ");
+    if (scanf(" %19s", dept) != 1) return;
+    printf("\t\t\t\t\tRoom Type (Lab/General, * for any): ");
+    if (scanf(" %9s", type) != 1) return;
+    to_lower_case(type);
+    printf("\t\t\t\t\tFloor (e.g., 1, * for any): ");
+    if (scanf(" %9s", floor) != 1) return;
+    printf("\t\t\t\t\tDays (e.g., Mon or Mon,Wed, or week): ");
+    if (scanf(" %39s", day_input) != 1) return;
+    printf("\t\t\t\t\tHours needed (1-24): ");
+    if (scanf("%d", &query.hours) != 1) {
+        while (getchar() != '\n');
+        printf("\t\t\t\t\tInvalid input.\n");
+        pause_and_clear();
+        return;
+    }
+    printf("\t\t\t\t\tShow earliest per room or all windows? (E/A): ");
+    if (scanf(" %9s", mode) != 1) return;
+    printf("\t\t\t\t\tMaximum results (e.g., 10): ");
+    if (scanf("%d", &limit) != 1 || limit < 1) limit = 10;
+    while (getchar() != '\n');
+
+    if (str_casecmp(day_input, "week") == 0) {
+        query.day_mask = 0x7F;
+    } else if (!parse_day_list(day_input, &query.day_mask)) {
+        printf("\t\t\t\t\tInvalid day. Please enter like 'Mon' or 'Mon,Wed'.\n");
+        pause_and_clear();
+        return;
+    }
+    if (query.hours < 1 || query.hours > 24) {
+        printf("\t\t\t\t\tHours must be between 1 and 24.\n");
+        pause_and_clear();
+        return;
+    }
+    query.first_only = toupper((unsigned char)mode[0]) != 'A';
+
+    FreeWindow *windows = malloc((size_t)limit * sizeof(*windows));
+    int found = 0;
+    if (windows && parse_window_filters(dept, type, floor, &query)) {
+        found = find_free_windows(&query, windows, limit);
+    }
+
+    printf("\n\t\t\t\t\tFree windows of %d hour(s), earliest first:\n", query.hours);
+    printf("\t\t\t\t\t--------------------------------\n");
+    for (int k = 0; k < found; k++) {
+        const Classroom *room = &rooms[windows[k].room_index];
+        char time_range[24];
+        format_hour_range(windows[k].hour, query.hours, time_range, sizeof(time_range));
+
+        set_text_color(10);
+        printf("\t\t\t\t\tRoom %d (Floor %d) | %s | %s %s\n", room->id, room->id / 100,
+               room->department, days[windows[k].day], time_range);
+        set_text_color(7);
+    }
+    if (found == 0) {
+        set_text_color(4);
+        printf("\t\t\t\t\tNo free window matches your criteria.\n");
+        set_text_color(7);
+    }
+    free(windows);
+    pause_and_clear();
+}
+
+int find_room_by_id(int room_id) {
+    if (room_id_index.capacity == 0) return -1;
+
+    uint32_t mask = (uint32_t)room_id_index.capacity - 1;
+    for (uint32_t pos = hash_room_id(room_id) & mask;
+         room_id_index.slots[pos] != 0;
+         pos = (pos + 1) & mask) {
+        int i = room_id_index.slots[pos] - 1;
+        if (rooms[i].id == room_id)
+            return i;
+    }
+    return -1;
+}
+
+int find_user_by_name(const char *username) {
+    if (username_index.capacity == 0) return -1;
+
+    uint32_t mask = (uint32_t)username_index.capacity - 1;
+    for (uint32_t pos = hash_username(username) & mask;
+         username_index.slots[pos] != 0;
+         pos = (pos + 1) & mask) {
+        int i = username_index.slots[pos] - 1;
+        if (strcmp(users[i].username, username) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int day_name_to_index(const char *day_name) {
+    for (int i = 0; i < 7; i++) {
+        if (strcasecmp(day_name, days[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+// Booking Operations
+// The menus and batch mode both go through these, so the availability,
+// ownership and persistence rules live in one place.
+
+// Per-room critical section for server mode; free when single-threaded
+void lock_room(int room_index) {
+#ifndef _WIN32
+    if (serving) pthread_mutex_lock(&room_locks[room_index % ROOM_LOCK_STRIPES]);
+#else
+    (void)room_index;
+#endif
+}
+
+void unlock_room(int room_index) {
+#ifndef _WIN32
+    if (serving) pthread_mutex_unlock(&room_locks[room_index % ROOM_LOCK_STRIPES]);
+#else
+    (void)room_index;
+#endif
+}
+
+// Atomically moves a slot to `booked`; false if it was already in that state
+bool claim_slot(Classroom *room, int day, int hour, bool booked) {
+    uint32_t bit = 1u << hour;
+#ifdef SLOTMAP_ATOMICS
+    uint32_t old = __atomic_load_n(&room->schedule[day], __ATOMIC_RELAXED);
+    uint32_t desired;
+    do {
+        if (((old & bit) != 0) == booked) return false;
+        desired = booked ? (old | bit) : (old & ~bit);
+    } while (!__atomic_compare_exchange_n(&room->schedule[day], &old, desired, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    return true;
+#else
+    if (((room->schedule[day] & bit) != 0) == booked) return false;
+    room->schedule[day] ^= bit;
+    return true;
+#endif
+}
+
+// Atomically sets every bit of `window` in one day word; false if any was taken
+bool claim_window(Classroom *room, int day, uint32_t window) {
+#ifdef SLOTMAP_ATOMICS
+    uint32_t old = __atomic_load_n(&room->schedule[day], __ATOMIC_RELAXED);
+    do {
+        if (old & window) return false;
+    } while (!__atomic_compare_exchange_n(&room->schedule[day], &old, old | window, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+    return true;
+#else
+    if (room->schedule[day] & window) return false;
+    room->schedule[day] |= window;
+    return true;
+#endif
+}
+
+OpStatus book_slot_as(int room_index, int day, int hour, int user_index) {
+    return book_range_as(room_index, 1 << day, hour, 1, user_index);
+}
+
+// Books `hours` consecutive slots on every day in day_mask, all or nothing
+OpStatus book_range_as(int room_index, int day_mask, int hour, int hours, int user_index) {
+    uint32_t window = ((hours >= 32) ? ~0u : ((1u << hours) - 1)) << hour;
+    int claimed = 0;
+    OpStatus status = OP_OK;
+    lock_room(room_index);
+
+    for (int d = 0; d < 7; d++) {
+        if (!(day_mask & (1 << d))) continue;
+        if (!claim_window(&rooms[room_index], d, window)) {
+            status = OP_SLOT_TAKEN;
+            break;
+        }
+        claimed |= 1 << d;
+    }
+
+    // Nor may it run over a sub-hour booking or one already made for a date
+    for (int d = 0; d < 7 && status == OP_OK; d++) {
+        int offset = d * MINUTES_PER_DAY;
+        if ((day_mask & (1 << d)) &&
+            interval_overlap(&room_intervals[room_index], offset + hour * 60, offset + (hour + hours) * 60) >= 0) {
+            status = OP_SLOT_TAKEN;
+        }
+    }
+    int dated_week, dated_day, dated_minute;
+    if (status == OP_OK &&
+        find_dated_conflict(room_index, day_mask, hour * 60, (hour + hours) * 60,
+                            &dated_week, &dated_day, &dated_minute)) {
+        status = OP_SLOT_TAKEN;
+    }
+    if (status == OP_OK && !wal_append_range(room_index, day_mask, hour, hours, true)) {
+        status = OP_SAVE_FAILED;
+    }
+    if (status != OP_OK) {
+        for (int d = 0; d < 7; d++) { // Rollback the days already claimed
+            if (!(claimed & (1 << d))) continue;
+#ifdef SLOTMAP_ATOMICS
+            __atomic_fetch_and(&rooms[room_index].schedule[d], ~window, __ATOMIC_ACQ_REL);
+#else
+            rooms[room_index].schedule[d] &= ~window;
+#endif
+        }
+    } else if (!append_booking_range_record(rooms[room_index].id, day_mask, hour, hours,
+                                            user_index, 'B')) {
+        status = OP_OK_UNLOGGED;
+    }
+
+    unlock_room(room_index);
+    return status;
+}
+
+OpStatus cancel_slot_as(int room_index, int day, int hour, int user_index) {
+    OpStatus status = OP_OK;
+    lock_room(room_index);
+
+    // Regular users may only cancel what they booked themselves
+    const SlotAction *last = &slot_history[room_index][day][hour];
+    bool owner_ok = users[user_index].is_admin || (last->action == 'B' && last->user == user_index);
+
+    if (!slot_is_booked(&rooms[room_index], day, hour)) {
+        status = OP_SLOT_FREE;
+    } else if (!owner_ok) {
+        status = OP_NOT_OWNER;
+    } else if (!claim_slot(&rooms[room_index], day, hour, false)) {
+        status = OP_SLOT_FREE;
+    } else if (!wal_append(room_index, day, hour, false)) {
+        set_slot_booked(&rooms[room_index], day, hour, true); // Rollback
+        status = OP_SAVE_FAILED;
+    } else if (!append_booking_record_with_action(rooms[room_index].id, day, hour,
+                                                  user_index, 'C')) {
+        status = OP_OK_UNLOGGED;
+    }
+
+    unlock_room(room_index);
+    return status;
+}
+
+// Appends a room with an empty schedule; returns its index or -1 when out of memory
+int create_classroom(int id, const char *dept, const char *type) {
+    if (!reserve_rooms(room_count + 1)) return -1;
+
+    Classroom *room = &rooms[room_count];
+    memset(room, 0, sizeof(*room));
+    room->id = id;
+    snprintf(room->department, sizeof(room->department), "%s", dept);
+    snprintf(room->type, sizeof(room->type), "%s", type);
+    to_lower_case(room->type);
+
+    room_count++;
+    index_room(room_count - 1);
+    group_room(room_count - 1);
+    return room_count - 1;
+}
+
+// Table Persistence
+// users.txt and rooms.dat are rewritten whole, so a change only marks its
+// table dirty and asks for a flush. Interactive changes are written at once,
+// batch mode writes at the end, and in server mode a flusher thread waits
+// flush_delay_ms after the first change so a burst costs one rewrite.
+// Tables that did not change are never rewritten.
+
+void lock_persist() {
+#ifndef _WIN32
+    if (serving) pthread_mutex_lock(&persist_lock);
+#endif
+}
+
+void unlock_persist() {
+#ifndef _WIN32
+    if (serving) pthread_mutex_unlock(&persist_lock);
+#endif
+}
+
+bool persist_rooms() {
+    lock_persist();
+    rooms_layout_dirty = true;
+    unlock_persist();
+    return request_flush();
+}
+
+bool persist_users() {
+    lock_persist();
+    users_dirty = true;
+    unlock_persist();
+    return request_flush();
+}
+
+// Flushes now unless the batch end or the server flusher will
+bool request_flush() {
+    if (defer_writes) return true;
+#ifndef _WIN32
+    if (flusher_running && flush_delay_ms > 0) {
+        pthread_mutex_lock(&persist_lock);
+        pthread_cond_signal(&persist_wake);
+        pthread_mutex_unlock(&persist_lock);
+        return true;
+    }
+#endif
+    return flush_dirty_tables();
+}
+
+// Rewrites the dirty tables; one that fails stays dirty for the next flush
+bool flush_dirty_tables() {
+    lock_persist();
+    bool write_users = users_dirty, write_rooms = rooms_layout_dirty;
+    users_dirty = rooms_layout_dirty = false;
+    unlock_persist();
+
+    bool ok = true;
+    if (write_users) {
+        lock_users();
+        bool saved = save_users();
+        unlock_users();
+        if (!saved) {
+            lock_persist();
+            users_dirty = true;
+            unlock_persist();
+            ok = false;
+        }
+    }
+    if (write_rooms && !save_rooms()) {
+        lock_persist();
+        rooms_layout_dirty = true;
+        unlock_persist();
+        ok = false;
+    }
+    return ok;
+}
+
+bool flush_deferred_writes() {
+    bool ok = flush_dirty_tables();
+    if (booking_log_fp && fflush(booking_log_fp) != 0) ok = false;
+    if (!checkpoint_rooms()) ok = false;
+    return ok;
+}
+
+// Calendar
+// Dated bookings ("Room 101 on 2026-10-20 at 9AM") sit on top of the weekly
+// timetable: a slot is free on a date only if neither the weekly schedule nor
+// that date has it booked. Storage is bucketed by calendar week (Sunday to
+// Saturday, like days[]), and a room's week is only allocated once something
+// is booked in it, so memory follows the number of dated bookings rather than
+// the span of dates. Weeks that have ended can be moved to calendar.dat by
+// evict_past_weeks(); bookings.dat stays the source of truth for the rest.
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar
+int days_from_civil(int year, int month, int day) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yoe = year - era * 400;
+    int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void civil_from_days(int days, int *year, int *month, int *day) {
+    days += 719468;
+    int era = (days >= 0 ? days : days - 146096) / 146097;
+    int doe = days - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = yoe + era * 400 + (*month <= 2);
+}
+
+// Accepts YYYY-MM-DD; the week number always fits BookingLogRecord.week
+bool parse_date(const char *text, int *week, int *day) {
+    if (strlen(text) != 10 || text[4] != '-' || text[7] != '-') return false;
+    for (int i = 0; i < 10; i++) {
+        if (i != 4 && i != 7 && !isdigit((unsigned char)text[i])) return false;
+    }
+
+    int year = atoi(text), month = atoi(text + 5), mday = atoi(text + 8);
+    static const int month_days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    if (year < 1971 || year > 2999 || month < 1 || month > 12 || mday < 1) return false;
+    if (mday > month_days[month - 1] + (month == 2 && leap)) return false;
+
+    int days_since = days_from_civil(year, month, mday) - CALENDAR_EPOCH_DAYS;
+    *week = days_since / 7;
+    *day = days_since % 7;
+    return true;
+}
+
+void format_date(int week, int day, char *out, size_t size) {
+    int year, month, mday;
+    civil_from_days(week * 7 + day + CALENDAR_EPOCH_DAYS, &year, &month, &mday);
+    snprintf(out, size, "%04d-%02d-%02d", year, month, mday);
+}
+
+void today_in_weeks(int *week, int *day) {
+    time_t now = time(NULL);
+    struct tm local;
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    int days_since = days_from_civil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday)
+                     - CALENDAR_EPOCH_DAYS;
+    *week = days_since / 7;
+    *day = days_since % 7;
+}
+
+bool date_has_passed(int week, int day) {
+    int this_week, this_day;
+    today_in_weeks(&this_week, &this_day);
+    return week < this_week || (week == this_week && day < this_day);
+}
+
+// Guards calendar_weeks, calendar_index and the room chains in server mode.
+// Taken after a room lock and the log lock, never before them.
+void lock_calendar() {
+#ifndef _WIN32
+    if (serving) pthread_mutex_lock(&calendar_lock);
+#endif
+}
+
+void unlock_calendar() {
+#ifndef _WIN32
+    if (serving) pthread_mutex_unlock(&calendar_lock);
+#endif
+}
+
+uint32_t hash_calendar_key(int room_index, int week) {
+    return hash_room_id(room_index) ^ ((uint32_t)week * 2246822519u);
+}
+
+bool rebuild_calendar_index() {
+    if (!hash_index_reset(&calendar_index, calendar_week_count)) return false;
+
+    uint32_t mask = (uint32_t)calendar_index.capacity - 1;
+    for (int k = 0; k < calendar_week_count; k++) {
+        const CalendarWeek *cw = calendar_weeks[k];
+        uint32_t pos = hash_calendar_key(cw->room_index, cw->week) & mask;
+        while (calendar_index.slots[pos] != 0) pos = (pos + 1) & mask;
+        calendar_index.slots[pos] = k + 1;
+        calendar_index.used++;
+    }
+    return true;
+}
+
+// Caller holds the calendar lock
+CalendarWeek *lookup_calendar_week(int room_index, int week) {
+    if (calendar_index.capacity == 0) return NULL;
+
+    uint32_t mask = (uint32_t)calendar_index.capacity - 1;
+    for (uint32_t pos = hash_calendar_key(room_index, week) & mask;
+         calendar_index.slots[pos] != 0;
+         pos = (pos + 1) & mask) {
+        CalendarWeek *cw = calendar_weeks[calendar_index.slots[pos] - 1];
+        if (cw->room_index == room_index && cw->week == week) return cw;
+    }
+    return NULL;
+}
+
+CalendarWeek *find_calendar_week(int room_index, int week) {
+    lock_calendar();
+    CalendarWeek *cw = lookup_calendar_week(room_index, week);
+    unlock_calendar();
+    return cw;
+}
+
+// The room's bucket for `week`, allocated on first use; NULL when out of memory.
+// Buckets are never moved, so the pointer stays valid until eviction.
+CalendarWeek *get_calendar_week(int room_index, int week) {
+    lock_calendar();
+    CalendarWeek *cw = lookup_calendar_week(room_index, week);
+    if (!cw && grow_array((void **)&calendar_weeks, &calendar_week_capacity,
+                          calendar_week_count + 1, sizeof(*calendar_weeks))) {
+        cw = calloc(1, sizeof(*cw));
+        if (cw) {
+            cw->room_index = room_index;
+            cw->week = week;
+            cw->next_in_room = room_calendar[room_index];
+            room_calendar[room_index] = calendar_week_count;
+            calendar_weeks[calendar_week_count++] = cw;
+
+            if ((calendar_index.used + 1) * 2 > calendar_index.capacity) {
+                if (!rebuild_calendar_index()) cw = NULL;
+            } else {
+                uint32_t mask = (uint32_t)calendar_index.capacity - 1;
+                uint32_t pos = hash_calendar_key(room_index, week) & mask;
+                while (calendar_index.slots[pos] != 0) pos = (pos + 1) & mask;
+                calendar_index.slots[pos] = calendar_week_count;
+                calendar_index.used++;
+            }
+        }
+    }
+    unlock_calendar();
+    return cw;
+}
+
+int calendar_owner(const CalendarWeek *cw, int day, int hour) {
+    for (int i = 0; i < cw->owner_count; i++) {
+        if (cw->owners[i].day == day && cw->owners[i].hour == hour) return cw->owners[i].user;
+    }
+    return -1;
+}
+
+// Replaces the owner of a slot; user -1 just drops it
+void set_calendar_owner(CalendarWeek *cw, int day, int hour, int user) {
+    for (int i = 0; i < cw->owner_count; i++) {
+        if (cw->owners[i].day == day && cw->owners[i].hour == hour) {
+            cw->owners[i] = cw->owners[--cw->owner_count];
+            break;
+        }
+    }
+    if (user == -1 || !grow_array((void **)&cw->owners, &cw->owner_capacity,
+                                cw->owner_count + 1, sizeof(*cw->owners))) {
+        return;
+    }
+    CalendarOwner *owner = &cw->owners[cw->owner_count++];
+    owner->day = (uint8_t)day;
+    owner->hour = (uint8_t)hour;
+    owner->user = user;
+}
+
+void reset_calendar() {
+    for (int k = 0; k < calendar_week_count; k++) {
+        free(calendar_weeks[k]->owners);
+        free(calendar_weeks[k]->intervals.items);
+        free(calendar_weeks[k]);
+    }
+    calendar_week_count = 0;
+    for (int i = 0; i < room_count; i++) room_calendar[i] = -1;
+    hash_index_reset(&calendar_index, 0);
+}
+
+// Dated counterpart of record_range_action(); caller holds the log lock
+void record_dated_action(int room_id, int week, int day, int hour, int hours, int user_index, char action, long record) {
+    int room_index = find_room_by_id(room_id);
+    if (room_index == -1 || day < 0 || day > 6) return;
+
+    if (user_index >= 0) add_user_history(user_index, record, false);
+    if (week < calendar_evicted_before) return; // settled in calendar.dat
+
+    CalendarWeek *cw = get_calendar_week(room_index, week);
+    if (!cw) return;
+
+    int told = -1; // previous owner already given this record
+    for (int h = hour; h < hour + hours && h < 24; h++) {
+        int owner = calendar_owner(cw, day, h);
+        if (action == 'C' && owner >= 0 && owner != user_index && owner != told) {
+            add_user_history(owner, record, true);
+            told = owner;
+        }
+        if (action == 'B') {
+            cw->schedule[day] |= 1u << h;
+            set_calendar_owner(cw, day, h, user_index);
+        } else {
+            cw->schedule[day] &= ~(1u << h);
+            set_calendar_owner(cw, day, h, -1);
+        }
+    }
+}
+
+// Dated bookings have no copy in rooms.dat, so the log write is the commit
+bool append_dated_record(int room_id, int week, int day, int hour, int hours, int user_index, char action) {
+    BookingLogRecord rec = {0};
+    rec.timestamp = (int64_t)time(NULL);
+    rec.room_id = room_id;
+    rec.user_id = user_index;
+    rec.day = (uint8_t)day;
+    rec.hour = (uint8_t)hour;
+    rec.hours = (uint8_t)hours;
+    rec.day_mask = (uint8_t)(1 << day);
+    rec.action = action;
+    rec.week = (uint16_t)week;
+
+    lock_booking_log();
+    long record = write_log_record(&rec);
+    if (record >= 0) record_dated_action(room_id, week, day, hour, hours, user_index, action, record);
+    unlock_booking_log();
+    return record >= 0;
+}
+
+// Books `hours` consecutive slots on one date, all or nothing
+OpStatus book_date_as(int room_index, int week, int day, int hour, int hours, int user_index) {
+    if (date_has_passed(week, day)) return OP_DATE_PASSED;
+
+    OpStatus status = OP_OK;
+    lock_room(room_index);
+
+    if (!room_free_for(room_index, week, day, hour * 60, (hour + hours) * 60)) {
+        status = OP_SLOT_TAKEN;
+    } else if (!get_calendar_week(room_index, week) ||
+               !append_dated_record(rooms[room_index].id, week, day, hour, hours, user_index, 'B')) {
+        status = OP_SAVE_FAILED;
+    }
+
+    unlock_room(room_index);
+    return status;
+}
+
+OpStatus cancel_date_as(int room_index, int week, int day, int hour, int user_index) {
+    if (date_has_passed(week, day)) return OP_DATE_PASSED;
+
+    OpStatus status = OP_OK;
+    lock_room(room_index);
+
+    const CalendarWeek *cw = find_calendar_week(room_index, week);
+    if (!cw || !(cw->schedule[day] & (1u << hour))) {
+        status = OP_SLOT_FREE;
+    } else if (!users[user_index].is_admin && calendar_owner(cw, day, hour) != user_index) {
+        status = OP_NOT_OWNER;
+    } else if (!append_dated_record(rooms[room_index].id, week, day, hour, 1, user_index, 'C')) {
+        status = OP_SAVE_FAILED;
+    }
+
+    unlock_room(room_index);
+    return status;
+}
+
+// Earliest upcoming dated booking that a weekly booking of [start, end)
+// minutes would run over. Only the room's own weeks are visited.
+bool find_dated_conflict(int room_index, int day_mask, int start, int end,
+                         int *out_week, int *out_day, int *out_minute) {
+    uint32_t window = hours_touched(start, end);
+    int this_week, this_day;
+    today_in_weeks(&this_week, &this_day);
+    bool found = false;
+
+    lock_calendar();
+    for (int k = room_calendar[room_index]; k != -1; k = calendar_weeks[k]->next_in_room) {
+        const CalendarWeek *cw = calendar_weeks[k];
+        if (cw->week < this_week) continue;
+        for (int d = 0; d < 7; d++) {
+            if (!(day_mask & (1 << d)) || (cw->week == this_week && d < this_day)) continue;
+            uint32_t bits = cw->schedule[d] & window;
+            int pos = interval_overlap(&cw->intervals, d * MINUTES_PER_DAY + start, d * MINUTES_PER_DAY + end);
+            if (!bits && pos < 0) continue;
+            if (!found || cw->week < *out_week || (cw->week == *out_week && d < *out_day)) {
+                int minute = bits ? lowest_bit(bits) * 60 : MINUTES_PER_DAY;
+                if (pos >= 0 && cw->intervals.items[pos].start - d * MINUTES_PER_DAY < minute) {
+                    minute = cw->intervals.items[pos].start - d * MINUTES_PER_DAY;
+                }
+                *out_week = cw->week;
+                *out_day = d;
+                *out_minute = minute < start ? start : minute;
+                found = true;
+            }
+        }
+    }
+    unlock_calendar();
+    return found;
+}
+
+// Dated bookings of every room on one date, indexed like rooms[]. Evicted
+// weeks are read back from calendar.dat in a single pass.
+bool dated_bits_for_day(int week, int day, uint32_t *bits) {
+    memset(bits, 0, (size_t)room_count * sizeof(*bits));
+
+    if (week >= calendar_evicted_before) {
+        lock_calendar();
+        for (int k = 0; k < calendar_week_count; k++) {
+            if (calendar_weeks[k]->week == week) {
+                bits[calendar_weeks[k]->room_index] = calendar_weeks[k]->schedule[day];
+            }
+        }
+        unlock_calendar();
+        return true;
+    }
+
+    FILE *fp = fopen(CALENDAR_FILE, "rb");
+    if (!fp) return false;
+    CalendarFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+              memcmp(header.magic, CALENDAR_MAGIC, 4) == 0 && header.version == CALENDAR_VERSION;
+    CalendarWeekRecord rec;
+    for (uint32_t i = 0; ok && i < header.week_count; i++) {
+        if (fread(&rec, sizeof(rec), 1, fp) != 1) {
+            ok = false;
+        } else if (rec.week == week) {
+            int room_index = find_room_by_id(rec.room_id);
+            if (room_index != -1) bits[room_index] |= rec.schedule[day];
+        }
+    }
+    fclose(fp);
+    return ok;
+}
+
+int compare_dated_slots(const void *a, const void *b) {
+    const DatedSlot *x = a, *y = b;
+    if (x->week != y->week) return x->week < y->week ? -1 : 1;
+    if (x->day != y->day) return x->day - y->day;
+    if (rooms[x->room_index].id != rooms[y->room_index].id) {
+        return rooms[x->room_index].id < rooms[y->room_index].id ? -1 : 1;
+    }
+    return x->start - y->start;
+}
+
+// Today's and later dated slots in date order, for one user or all (-1);
+// the caller frees the result
+DatedSlot *collect_dated_slots(int user_index, int *count) {
+    int this_week, this_day;
+    today_in_weeks(&this_week, &this_day);
+
+    DatedSlot *slots = NULL;
+    int capacity = 0;
+    *count = 0;
+
+    lock_calendar();
+    for (int k = 0; k < calendar_week_count; k++) {
+        const CalendarWeek *cw = calendar_weeks[k];
+        if (cw->week < this_week) continue;
+        for (int i = 0; i < cw->owner_count; i++) {
+            const CalendarOwner *owner = &cw->owners[i];
+            if (cw->week == this_week && owner->day < this_day) continue;
+            if (user_index >= 0 && owner->user != user_index) continue;
+            if (!grow_array((void **)&slots, &capacity, *count + 1, sizeof(*slots))) break;
+            DatedSlot *slot = &slots[(*count)++];
+            slot->room_index = cw->room_index;
+            slot->week = cw->week;
+            slot->day = owner->day;
+            slot->start = owner->hour * 60;
+            slot->end = slot->start + 60;
+            slot->user = owner->user;
+        }
+        for (int i = 0; i < cw->intervals.count; i++) {
+            const Interval *it = &cw->intervals.items[i];
+            int day = it->start / MINUTES_PER_DAY;
+            if (cw->week == this_week && day < this_day) continue;
+            if (user_index >= 0 && it->user != user_index) continue;
+            if (!grow_array((void **)&slots, &capacity, *count + 1, sizeof(*slots))) break;
+            DatedSlot *slot = &slots[(*count)++];
+            slot->room_index = cw->room_index;
+            slot->week = cw->week;
+            slot->day = day;
+            slot->start = it->start - day * MINUTES_PER_DAY;
+            slot->end = it->end - day * MINUTES_PER_DAY;
+            slot->user = it->user;
+        }
+    }
+    unlock_calendar();
+
+    if (*count > 1) qsort(slots, (size_t)*count, sizeof(*slots), compare_dated_slots);
+    return slots;
+}
+
+// Reads which weeks have already been moved out of memory
+bool load_calendar_header() {
+    calendar_evicted_before = 0;
+    FILE *fp = fopen(CALENDAR_FILE, "rb");
+    if (!fp) return true;
+
+    CalendarFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+              memcmp(header.magic, CALENDAR_MAGIC, 4) == 0 && header.version == CALENDAR_VERSION;
+    fclose(fp);
+    if (ok) calendar_evicted_before = header.evicted_before;
+    return ok;
+}
+
+// Appends every week that ended before this one to calendar.dat and frees
+// it. Not available while serving, since other threads may hold buckets.
+// Returns the number of weeks moved, or -1.
+long evict_past_weeks() {
+    if (serving) return -1;
+
+    int this_week, this_day;
+    today_in_weeks(&this_week, &this_day);
+    if (this_week <= calendar_evicted_before) return 0;
+
+    CalendarFileHeader header;
+    FILE *fp = fopen(CALENDAR_FILE, "r+b");
+    if (fp) {
+        if (fread(&header, sizeof(header), 1, fp) != 1 ||
+            memcmp(header.magic, CALENDAR_MAGIC, 4) != 0 || header.version != CALENDAR_VERSION) {
+            fclose(fp);
+            return -1; // never overwrite a file this version cannot read
+        }
+    } else {
+        fp = fopen(CALENDAR_FILE, "w+b");
+        if (!fp) return -1;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CALENDAR_MAGIC, 4);
+        header.version = CALENDAR_VERSION;
+    }
+
+    bool ok = fseek(fp, (long)(sizeof(header) + header.week_count * sizeof(CalendarWeekRecord)),
+                    SEEK_SET) == 0;
+    long moved = 0;
+    for (int k = 0; ok && k < calendar_week_count; k++) {
+        const CalendarWeek *cw = calendar_weeks[k];
+        if (cw->week >= this_week) continue;
+
+        CalendarWeekRecord rec = {0};
+        rec.room_id = rooms[cw->room_index].id;
+        rec.week = cw->week;
+        // Sub-hour bookings are kept at hour resolution once evicted
+        uint32_t any = 0;
+        for (int d = 0; d < 7; d++) {
+            rec.schedule[d] = cw->schedule[d] | interval_day_hours(&cw->intervals, d);
+            any |= rec.schedule[d];
+        }
+        if (any == 0) continue; // everything was cancelled
+        if (fwrite(&rec, sizeof(rec), 1, fp) != 1) ok = false;
+        moved++;
+    }
+
+    // The header goes last, so a failed append leaves the old view intact
+    header.week_count += (uint32_t)moved;
+    header.evicted_before = this_week;
+    if (ok && !sync_file(fp)) ok = false;
+    if (ok && (fseek(fp, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, fp) != 1)) ok = false;
+    if (ok && !sync_file(fp)) ok = false;
+    if (fclose(fp) != 0) ok = false;
+    if (!ok) return -1;
+
+    int kept = 0;
+    for (int k = 0; k < calendar_week_count; k++) {
+        CalendarWeek *cw = calendar_weeks[k];
+        if (cw->week < this_week) {
+            free(cw->owners);
+            free(cw->intervals.items);
+            free(cw);
+        } else {
+            calendar_weeks[kept++] = cw;
+        }
+    }
+    calendar_week_count = kept;
+    calendar_evicted_before = this_week;
+
+    for (int i = 0; i < room_count; i++) room_calendar[i] = -1;
+    for (int k = 0; k < calendar_week_count; k++) {
+        CalendarWeek *cw = calendar_weeks[k];
+        cw->next_in_room = room_calendar[cw->room_index];
+        room_calendar[cw->room_index] = k;
+    }
+    rebuild_calendar_index();
+    return moved;
+}
+
+// Interval Index
+// Whole-hour bookings stay in the schedule bitmaps, where a lookup is a
+// single AND. Anything on a finer grid (9:30AM, 90 minutes) is kept as an
+// interval instead: one sorted array per room for the weekly timetable and
+// one per room-week for dated bookings. Intervals never overlap, so "free at
+// T" and "free for [start, end)" only look at the predecessor of `start` and
+// the interval after it, found by binary search.
+
+// Last interval starting at or before `minute`, or -1
+int interval_floor(const IntervalIndex *index, int minute) {
+    int lo = 0, hi = index->count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (index->items[mid].start <= minute) lo = mid + 1; else hi = mid;
+    }
+    return lo - 1;
+}
+
+int interval_containing(const IntervalIndex *index, int minute) {
+    int pos = interval_floor(index, minute);
+    return (pos >= 0 && index->items[pos].end > minute) ? pos : -1;
+}
+
+// Some interval sharing a minute with [start, end), or -1
+int interval_overlap(const IntervalIndex *index, int start, int end) {
+    int pos = interval_floor(index, start);
+    if (pos >= 0 && index->items[pos].end > start) return pos;
+    if (pos + 1 < index->count && index->items[pos + 1].start < end) return pos + 1;
+    return -1;
+}
+
+// The caller has checked that nothing overlaps
+bool interval_insert(IntervalIndex *index, int start, int end, int user) {
+    if (!grow_array((void **)&index->items, &index->capacity, index->count + 1, sizeof(*index->items))) {
+        return false;
+    }
+    int pos = interval_floor(index, start) + 1;
+    memmove(index->items + pos + 1, index->items + pos, (size_t)(index->count - pos) * sizeof(*index->items));
+    index->items[pos].start = start;
+    index->items[pos].end = end;
+    index->items[pos].user = user;
+    index->count++;
+    return true;
+}
+
+void interval_remove(IntervalIndex *index, int pos) {
+    index->count--;
+    memmove(index->items + pos, index->items + pos + 1, (size_t)(index->count - pos) * sizeof(*index->items));
+}
+
+// Hour bits of a schedule word that [start, end) minutes of a day touch
+uint32_t hours_touched(int start, int end) {
+    int first = start / 60, last = (end + 59) / 60;
+    return (DAY_MASK >> (24 - (last - first))) << first;
+}
+
+// Hours of `day` that have any sub-hour booking, for the hour-based views
+uint32_t interval_day_hours(const IntervalIndex *index, int day) {
+    int day_start = day * MINUTES_PER_DAY, day_end = day_start + MINUTES_PER_DAY;
+    uint32_t hours = 0;
+    int pos = interval_floor(index, day_start);
+    if (pos < 0) pos = 0;
+    for (; pos < index->count && index->items[pos].start < day_end; pos++) {
+        if (index->items[pos].end <= day_start) continue;
+        hours |= hours_touched(index->items[pos].start - day_start, index->items[pos].end - day_start);
+    }
+    return hours;
+}
+
+// Weekly hours of `day` in use by whole-hour or sub-hour bookings. Takes the
+// room lock: server clients may be growing the interval array.
+uint32_t room_busy_hours(int room_index, int day) {
+    lock_room(room_index);
+    uint32_t busy = rooms[room_index].schedule[day] |
+                    interval_day_hours(&room_intervals[room_index], day);
+    unlock_room(room_index);
+    return busy;
+}
+
+// Nothing weekly, and nothing booked for that date when week > 0, touches
+// [start, end) minutes of `day`. Dated weeks must still be in memory.
+bool room_free_for(int room_index, int week, int day, int start, int end) {
+    int offset = day * MINUTES_PER_DAY;
+    uint32_t window = hours_touched(start, end);
+
+    if (rooms[room_index].schedule[day] & window) return false;
+    if (interval_overlap(&room_intervals[room_index], offset + start, offset + end) >= 0) return false;
+    return week <= 0 || room_dated_free_for(room_index, week, day, start, end);
+}
+
+// Only the bookings made for calendar week `week`, which must be in memory
+bool room_dated_free_for(int room_index, int week, int day, int start, int end) {
+    int offset = day * MINUTES_PER_DAY;
+    uint32_t window = hours_touched(start, end);
+    const CalendarWeek *cw = find_calendar_week(room_index, week);
+    return !cw || (!(cw->schedule[day] & window) &&
+                   interval_overlap(&cw->intervals, offset + start, offset + end) < 0);
+}
+
+bool room_free_at(int room_index, int week, int day, int minute) {
+    return room_free_for(room_index, week, day, minute, minute + 1);
+}
+
+// Sub-hour counterpart of record_range_action(); caller holds the log lock
+void record_interval_action(int room_id, int week, int day_mask, int start, int end, int user_index, char action, long record) {
+    int room_index = find_room_by_id(room_id);
+    if (room_index == -1) return;
+
+    if (user_index >= 0) add_user_history(user_index, record, false);
+    if (week > 0 && week < calendar_evicted_before) return; // settled in calendar.dat
+
+    IntervalIndex *index = &room_intervals[room_index];
+    if (week > 0) {
+        CalendarWeek *cw = get_calendar_week(room_index, week);
+        if (!cw) return;
+        index = &cw->intervals;
+    }
+
+    int told = -1; // previous owner already given this record
+    for (int d = 0; d < 7; d++) {
+        if (!(day_mask & (1 << d))) continue;
+        int s = d * MINUTES_PER_DAY + start, e = d * MINUTES_PER_DAY + end;
+
+        if (action == 'B') {
+            int pos;
+            while ((pos = interval_overlap(index, s, e)) >= 0) interval_remove(index, pos); // log order wins
+            interval_insert(index, s, e, user_index);
+            if (week == 0 && user_index >= 0) add_interval_room(user_index, room_index);
+            continue;
+        }
+
+        int pos = interval_containing(index, s);
+        if (pos < 0) continue;
+        int owner = index->items[pos].user;
+        if (owner >= 0 && owner != user_index && owner != told) {
+            add_user_history(owner, record, true);
+            told = owner;
+        }
+        interval_remove(index, pos);
+    }
+}
+
+// Sub-hour bookings have no copy in rooms.dat, so the log write is the commit
+bool append_interval_record(int room_id, int week, int day_mask, int start, int end, int user_index, char action) {
+    BookingLogRecord rec = {0};
+    rec.timestamp = (int64_t)time(NULL);
+    rec.room_id = room_id;
+    rec.user_id = user_index;
+    while (!(day_mask & (1 << rec.day))) rec.day++;
+    rec.hour = (uint8_t)(start / 15);
+    rec.hours = (uint8_t)((end - start) / 15);
+    rec.day_mask = (uint8_t)day_mask;
+    rec.action = action;
+    rec.flags = LOG_FLAG_QUARTERS;
+    rec.week = (uint16_t)week;
+
+    lock_booking_log();
+    long record = write_log_record(&rec);
+    if (record >= 0) {
+        record_interval_action(room_id, week, day_mask, start, end, user_index, action, record);
+    }
+    unlock_booking_log();
+    return record >= 0;
+}
+
+// Books [start, end) minutes on every day in day_mask, or on one date when
+// week > 0, all or nothing
+OpStatus book_interval_as(int room_index, int week, int day_mask, int start, int end, int user_index) {
+    if (week > 0 && date_has_passed(week, lowest_bit((uint32_t)day_mask))) return OP_DATE_PASSED;
+
+    OpStatus status = OP_OK;
+    lock_room(room_index);
+
+    for (int d = 0; d < 7 && status == OP_OK; d++) {
+        if ((day_mask & (1 << d)) && !room_free_for(room_index, week, d, start, end)) {
+            status = OP_SLOT_TAKEN;
+        }
+    }
+    int dated_week, dated_day, dated_minute;
+    if (status == OP_OK && week == 0 &&
+        find_dated_conflict(room_index, day_mask, start, end, &dated_week, &dated_day, &dated_minute)) {
+        status = OP_SLOT_TAKEN;
+    }
+    if (status == OP_OK &&
+        ((week > 0 && !get_calendar_week(room_index, week)) ||
+         !append_interval_record(rooms[room_index].id, week, day_mask, start, end, user_index, 'B'))) {
+        status = OP_SAVE_FAILED;
+    }
+
+    unlock_room(room_index);
+    return status;
+}
+
+// Cancels the whole sub-hour booking that covers `minute`; OP_SLOT_FREE if none
+OpStatus cancel_interval_as(int room_index, int week, int day, int minute, int user_index) {
+    if (week > 0 && date_has_passed(week, day)) return OP_DATE_PASSED;
+
+    OpStatus status = OP_OK;
+    lock_room(room_index);
+
+    const IntervalIndex *index = &room_intervals[room_index];
+    if (week > 0) {
+        const CalendarWeek *cw = find_calendar_week(room_index, week);
+        index = cw ? &cw->intervals : NULL;
+    }
+    int offset = day * MINUTES_PER_DAY;
+    int pos = index ? interval_containing(index, offset + minute) : -1;
+
+    if (pos < 0) {
+        status = OP_SLOT_FREE;
+    } else if (!users[user_index].is_admin && index->items[pos].user != user_index) {
+        status = OP_NOT_OWNER;
+    } else if (!append_interval_record(rooms[room_index].id, week, 1 << day,
+                                       index->items[pos].start - offset, index->items[pos].end - offset,
+                                       user_index, 'C')) {
+        status = OP_SAVE_FAILED;
+    }
+
+    unlock_room(room_index);
+    return status;
+}
+
+// Entry point for menus and commands: whole hours keep using the bitmaps
+OpStatus book_minutes_as(int room_index, int week, int day_mask, int start, int end, int user_index) {
+    if (start % 60 != 0 || end % 60 != 0) {
+        return book_interval_as(room_index, week, day_mask, start, end, user_index);
+    }
+    if (week > 0) {
+        return book_date_as(room_index, week, lowest_bit((uint32_t)day_mask), start / 60,
+                            (end - start) / 60, user_index);
+    }
+    return book_range_as(room_index, day_mask, start / 60, (end - start) / 60, user_index);
+}
+
+// A time inside a sub-hour booking cancels that booking; on the hour it
+// otherwise cancels the hourly slot
+OpStatus cancel_minutes_as(int room_index, int week, int day, int minute, int user_index) {
+    OpStatus status = cancel_interval_as(room_index, week, day, minute, user_index);
+    if (status != OP_SLOT_FREE || minute % 60 != 0) return status;
+    return week > 0 ? cancel_date_as(room_index, week, day, minute / 60, user_index)
+                    : cancel_slot_as(room_index, day, minute / 60, user_index);
+}
+
+// First booking that [start, end) on the days in day_mask, or on that date
+// when week > 0, runs into, and who holds it (-1 if unknown); for reporting
+bool find_booking_conflict(int room_index, int week, int day_mask, int start, int end,
+                           int *out_week, int *out_day, int *out_minute, int *out_user) {
+    uint32_t window = hours_touched(start, end);
+    for (int d = 0; d < 7; d++) {
+        if (!(day_mask & (1 << d))) continue;
+        int offset = d * MINUTES_PER_DAY;
+        const CalendarWeek *cw = week > 0 ? find_calendar_week(room_index, week) : NULL;
+        const IntervalIndex *indexes[2] = {&room_intervals[room_index], cw ? &cw->intervals : NULL};
+        uint32_t bits[2] = {rooms[room_index].schedule[d] & window, cw ? cw->schedule[d] & window : 0};
+
+        *out_day = d;
+        for (int k = 0; k < 2; k++) {
+            *out_week = k == 0 ? 0 : week;
+            if (bits[k]) {
+                int h = lowest_bit(bits[k]);
+                const SlotAction *slot = &slot_history[room_index][d][h];
+                *out_minute = h * 60 < start ? start : h * 60;
+                *out_user = k == 0 ? (slot->action == 'B' ? slot->user : -1) : calendar_owner(cw, d, h);
+                return true;
+            }
+            int pos = indexes[k] ? interval_overlap(indexes[k], offset + start, offset + end) : -1;
+            if (pos >= 0) {
+                int minute = indexes[k]->items[pos].start - offset;
+                *out_minute = minute < start ? start : minute;
+                *out_user = indexes[k]->items[pos].user;
+                return true;
+            }
+        }
+    }
+
+    // A weekly booking can also be refused by an upcoming dated one
+    if (week == 0 && find_dated_conflict(room_index, day_mask, start, end, out_week, out_day, out_minute)) {
+        const CalendarWeek *cw = find_calendar_week(room_index, *out_week);
+        int pos = cw ? interval_containing(&cw->intervals, *out_day * MINUTES_PER_DAY + *out_minute) : -1;
+        *out_user = !cw ? -1 : pos >= 0 ? cw->intervals.items[pos].user
+                                        : calendar_owner(cw, *out_day, *out_minute / 60);
+        return true;
+    }
+    return false;
+}
+
+void book_slot() {
+    if (current_user_index == -1) {
+        printf("\t\t\t\t\tYou must be logged in to book a slot.\n");
+        pause_and_clear();
+        return;
+    }
+
+    int room_id, start = 0, end = 0, day_mask; // minutes from midnight
+    int day = -1, week = 0; // week > 0 books a single date
+    char day_str[12];
+    char hour_input[20];
+    char length_input[20];
+    char repeat_input[40];
+    bool valid_input = false;
+
+    // Room ID input with validation
+    while (!valid_input) {
+        printf("\t\t\t\t\tEnter Room ID (e.g., 101, 202, 303): ");
+        if (scanf("%d", &room_id) != 1) {
+            while (getchar() != '\n');
+            printf("\t\t\t\t\tInvalid input. Please enter a number.\n");
+            continue;
+        }
+
+        if (!validate_room_id(room_id)) {
+            printf("\t\t\t\t\tInvalid Room ID. Must be a positive number (e.g., 101).\n");
+            continue;
+        }
+
+        if (find_room_by_id(room_id) == -1) {
+            printf("\t\t\t\t\tRoom ID not found. Please try again.\n");
+            continue;
+        }
+
+        valid_input = true;
+    }
+
+    int room_index = find_room_by_id(room_id);
+    valid_input = false;
+
+    // Day input with validation; a date books that one day only
+    while (!valid_input) {
+        printf("\t\t\t\t\tEnter Day (Sun, Mon, Tue, Wed, Thu, Fri, Sat) or Date (YYYY-MM-DD): ");
+        if (scanf("%11s", day_str) != 1) {
+            while (getchar() != '\n');
+            printf("\t\t\t\t\tInvalid input.\n");
+            continue;
+        }
+
+        week = 0;
+        if (!parse_date(day_str, &week, &day)) day = day_name_to_index(day_str);
+        if (day == -1) {
+            printf("\t\t\t\t\tInvalid day. Please enter a date or one of: ");
+            for (int i = 0; i < 7; i++) {
+                printf("%s%s", days[i], (i < 6) ? ", " : "\n");
+            }
+            continue;
+        }
+        if (week > 0 && date_has_passed(week, day)) {
+            printf("\t\t\t\t\tThat date has already passed.\n");
+            continue;
+        }
+
+        valid_input = true;
+    }
+
+    valid_input = false;
+
+    // Clear input buffer before time input
+    while (getchar() != '\n');
+
+    // Time input with AM/PM validation
+    while (!valid_input) {
+        printf("\t\t\t\t\tEnter Time (e.g., 9 AM, 2 PM, 9:30 AM): ");
+        fgets(hour_input, sizeof(hour_input), stdin);
+        hour_input[strcspn(hour_input, "\n")] = '\0'; // Remove newline
+
+        if (parse_time_input(hour_input, &start) && start % slot_minutes == 0) {
+            // Optional length and weekly repeat; only an empty answer means one hour
+            int length = 60;
+            bool length_ok = false;
+            while (!length_ok) {
+                printf("\t\t\t\t\tLength (hours like 2 or 1.5, minutes like 90m; Enter for 1 hour): ");
+                if (!read_line(length_input, sizeof(length_input))) return;
+                length = 60;
+                if (length_input[0] != '\0' && !parse_duration(length_input, &length)) {
+                    printf("\t\t\t\t\tInvalid length. Enter hours like 2 or 1.5, or minutes like 90m.\n");
+                } else if (start + length > MINUTES_PER_DAY) {
+                    printf("\t\t\t\t\tBooking must end by midnight.\n");
+                } else if (!valid_booking_span(start, start + length)) {
+                    printf("\t\t\t\t\tLengths must be multiples of %d minutes.\n", slot_minutes);
+                } else {
+                    length_ok = true;
+                }
+            }
+            end = start + length;
+
+            int repeat_mask = 0;
+            if (week == 0) {
+                printf("\t\t\t\t\tRepeat on other days (e.g. Wed,Fri; Enter for none): ");
+                fgets(repeat_input, sizeof(repeat_input), stdin);
+                repeat_input[strcspn(repeat_input, "\n")] = '\0';
+                if (repeat_input[0] != '\0' && !parse_day_list(repeat_input, &repeat_mask)) {
+                    printf("\t\t\t\t\tUnrecognized days, booking %s only.\n", day_str);
+                }
+            }
+            day_mask = (1 << day) | repeat_mask;
+
+            char day_list[40], time_range[24];
+            format_booking_days(week, day_mask, day_list, sizeof(day_list));
+            format_minute_range(start, end, time_range, sizeof(time_range));
+            printf("\t\t\t\t\tConfirm booking for Room %d on %s at %s? (Y/N): ",
+                  room_id, day_list, time_range);
+
+            char confirm = getchar();
+            while (getchar() != '\n'); // Clear buffer
+
+            if (toupper(confirm) == 'Y') {
+                valid_input = true;
+            } else {
+                printf("\t\t\t\t\tBooking cancelled.\n");
+                pause_and_clear();
+                return;
+            }
+        } else {
+            printf("\t\t\t\t\tInvalid time. Please enter like '9 AM' or '9:30 AM' (steps of %d minutes).\n",
+                   slot_minutes);
+        }
+    }
+
+    OpStatus status = book_minutes_as(room_index, week, day_mask, start, end, current_user_index);
+
+    if (status == OP_SLOT_TAKEN) {
+        int conflict_week = week, conflict_day = day, conflict_minute = start, holder = -1;
+        find_booking_conflict(room_index, week, day_mask, start, end,
+                              &conflict_week, &conflict_day, &conflict_minute, &holder);
+
+        char ampm_display[10], when[40];
+        minute_to_ampm(conflict_minute, ampm_display);
+        format_booking_days(conflict_week, 1 << conflict_day, when, sizeof(when));
+        if (holder >= 0) {
+            printf("\t\t\t\t\tSlot on %s at %s already booked by %s.\n",
+                  when, ampm_display, users[holder].username);
+        } else {
+            printf("\t\t\t\t\tSlot on %s at %s is already booked.\n",
+                  when, ampm_display);
+        }
+        printf("\t\t\t\t\tNothing was booked.\n");
+        pause_and_clear();
+        return;
+    }
+
+    if (status == OP_DATE_PASSED) {
+        printf("\t\t\t\t\tThat date has already passed.\n");
+        pause_and_clear();
+        return;
+    }
+
+    if (status == OP_SAVE_FAILED) {
+        printf("\t\t\t\t\tError: Failed to save room schedule!\n");
+        pause_and_clear();
+        return;
+    }
+
+    if (status == OP_OK_UNLOGGED) {
+        printf("\t\t\t\t\tWarning: Booking record not saved, but slot is booked!\n");
+    }
+
+    int floor = rooms[room_index].id / 100;
+    char day_list[40], time_range[24];
+    format_booking_days(week, day_mask, day_list, sizeof(day_list));
+    format_minute_range(start, end, time_range, sizeof(time_range));
+
+    set_text_color(10); // Green
+    printf("\t\t\t\t\tBooking successful!\n");
+    printf("\t\t\t\t\tRoom: %d (Floor %d)\n", room_id, floor);
+    printf("\t\t\t\t\tDay: %s\n", day_list);
+    printf("\t\t\t\t\tTime: %s\n", time_range);
+    set_text_color(7); // Reset
+
+    pause_and_clear();
+}
+
+void cancel_booking() {
+    if (current_user_index == -1) {
+        printf("\t\t\t\t\tYou must be logged in to cancel a booking.\n");
+        pause_and_clear();
+        return;
+    }
+
+    int room_id, minute;
+    int day = -1, week = 0; // week > 0 cancels on a single date
+    char day_str[12];
+    char hour_input[20];
+    bool valid_input = false;
+    bool is_admin = users[current_user_index].is_admin;
+
+    // Room ID input with validation
+    while (!valid_input) {
+        printf("\t\t\t\t\tEnter Room ID (e.g., 101, 202, 303): ");
+        if (scanf("%d", &room_id) != 1) {
+            while (getchar() != '\n');
+            printf("\t\t\t\t\tInvalid input. Please enter a number.\n");
+            continue;
+        }
+
+        if (!validate_room_id(room_id)) {
+            printf("\t\t\t\t\tInvalid Room ID. Must be a positive number (e.g., 101).\n");
+            continue;
+        }
+
+        if (find_room_by_id(room_id) == -1) {
+            printf("\t\t\t\t\tRoom ID not found. Please try again.\n");
+            continue;
+        }
+
+        valid_input = true;
+    }
+
+    int room_index = find_room_by_id(room_id);
+    valid_input = false;
+
+    // Day input with validation
+    while (!valid_input) {
+        printf("\t\t\t\t\tEnter Day (Sun, Mon, Tue, Wed, Thu, Fri, Sat) or Date (YYYY-MM-DD): ");
+        if (scanf("%11s", day_str) != 1) {
+            while (getchar() != '\n');
+            printf("\t\t\t\t\tInvalid input.\n");
+            continue;
+        }
+
+        week = 0;
+        if (!parse_date(day_str, &week, &day)) day = day_name_to_index(day_str);
+        if (day == -1) {
+            printf("\t\t\t\t\tInvalid day. Please enter a date or one of: ");
+            for (int i = 0; i < 7; i++) {
+                printf("%s%s", days[i], (i < 6) ? ", " : "\n");
+            }
+            continue;
+        }
+
+        valid_input = true;
+    }
+
+    // Clear input buffer before time input
+    while (getchar() != '\n');
+
+    // Time input with AM/PM validation
+    valid_input = false;
+    while (!valid_input) {
+        printf("\t\t\t\t\tEnter Time (e.g., 9 AM, 2 PM, 9:30 AM): ");
         fgets(hour_input, sizeof(hour_input), stdin);
-        hour_input[strcspn(hour_input, "\n")] = '\0'; // Remove newline
+        hour_input[strcspn(hour_input, "\n")] = '\0';
+
+        if (parse_time_input(hour_input, &minute)) {
+            char ampm_display[10];
+            minute_to_ampm(minute, ampm_display);
+            printf("\t\t\t\t\tConfirm cancellation for Room %d on %s at %s? (Y/N): ",
+                  room_id, day_str, ampm_display);
+
+            char confirm = getchar();
+            while (getchar() != '\n');
+
+            if (toupper(confirm) == 'Y') {
+                valid_input = true;
+            } else {
+                printf("\t\t\t\t\tCancellation aborted by user.\n");
+                pause_and_clear();
+                return;
+            }
+        } else {
+            printf("\t\t\t\t\tInvalid time format. Please enter like '9 AM' or '9:30 AM'.\n");
+        }
+    }
+
+    OpStatus status = cancel_minutes_as(room_index, week, day, minute, current_user_index);
+
+    if (status == OP_DATE_PASSED) {
+        printf("\t\t\t\t\tThat date has already passed.\n");
+        pause_and_clear();
+        return;
+    }
+
+    if (status == OP_SLOT_FREE) {
+        printf("\t\t\t\t\tSlot is not currently booked.\n");
+        pause_and_clear();
+        return;
+    }
+
+    if (status == OP_NOT_OWNER) {
+        printf("\t\t\t\t\tYou can only cancel your own bookings.\n");
+        pause_and_clear();
+        return;
+    }
+
+    if (status == OP_SAVE_FAILED) {
+        printf("\t\t\t\t\tError: Failed to save changes!\n");
+        pause_and_clear();
+        return;
+    }
+
+    if (status == OP_OK_UNLOGGED) {
+        printf("\t\t\t\t\tWarning: Cancellation not logged!\n");
+    }
+
+    // Success message with AM/PM display
+    char ampm_display[10];
+    minute_to_ampm(minute, ampm_display);
+    set_text_color(10); // Green
+    printf("\t\t\t\t\tCancellation successful!\n");
+    printf("\t\t\t\t\tRoom: %d\n", room_id);
+    printf("\t\t\t\t\tDay: %s\n", day_str);
+    printf("\t\t\t\t\tTime: %s\n", ampm_display);
+
+    if (is_admin) {
+        printf("\t\t\t\t\t(Admin cancellation performed)\n");
+    }
+
+    set_text_color(7); // Reset
+    pause_and_clear();
+}
+
+void add_classroom() {
+    if (current_user_index == -1 || !users[current_user_index].is_admin) {
+        printf("\t\t\t\t\tOnly admins can add classrooms.\n");
+        pause_and_clear();
+        return;
+    }
+
+    if (!reserve_rooms(room_count + 1)) {
+        printf("\t\t\t\t\tOut of memory: cannot add more rooms.\n");
+        pause_and_clear();
+        return;
+    }
+
+    int id;
+    char dept[20], type[10];
+
+    printf("\t\t\t\t\tEnter room ID (floor then room, e.g., 101 or 1204): ");
+    if (scanf("%d", &id) != 1) {
+        while (getchar() != '\n');
+        printf("\t\t\t\t\tInvalid input.\n");
+        pause_and_clear();
+        return;
+    }
+
+    if (!validate_room_id(id)) {
+        printf("\t\t\t\t\tInvalid room ID. Must be a positive number (e.g., 101).\n");
+        pause_and_clear();
+        return;
+    }
+
+    if (find_room_by_id(id) != -1) {
+        printf("\t\t\t\t\tA room with this ID already exists.\n");
+        pause_and_clear();
+        return;
+    }
+
+    printf("\t\t\t\t\tEnter department: ");
+    scanf(" %19s", dept);
+
+    while (1) {
+        printf("\t\t\t\t\tEnter room type (Lab/General): ");
+        scanf(" %9s", type);
+        to_lower_case(type);
+        if (validate_room_type(type))
+            break;
+        printf("\t\t\t\t\tInvalid type. Please enter 'Lab' or 'General'.\n");
+    }
+
+    if (create_classroom(id, dept, type) == -1) {
+        printf("\t\t\t\t\tOut of memory: cannot add more rooms.\n");
+        pause_and_clear();
+        return;
+    }
+
+    if (!persist_rooms()) {
+        printf("\t\t\t\t\tWarning: Failed to save rooms to file!\n");
+    } else {
+        printf("\t\t\t\t\tClassroom added and saved successfully.\n");
+    }
+    pause_and_clear();
+}
+
+const char* day_index_to_name(int day) {
+    if (day >= 0 && day < 7) {
+        return days[day];
+    }
+    return "Invalid";
+}
+
+void print_all_bookings(Screen *out) {
+    screen_color(out, 14); // Yellow
+    screen_printf(out, "\n\t\t\t\t\tAll Classroom Bookings (Current Status)\n");
+    screen_printf(out, "\t\t\t\t\t--------------------------------------\n");
+    screen_color(out, 7); // Reset
+
+    bool any_bookings = false;
+
+    for (int i = 0; i < room_count; i++) {
+        bool room_has_bookings = false;
+
+        // Print room header
+        screen_color(out, 11); // Cyan
+        screen_printf(out, "\n\t\t\t\t\tRoom %d | %s | %s\n",
+              rooms[i].id, rooms[i].department, rooms[i].type);
+        screen_color(out, 7); // Reset
+
+        // Check each day and hour
+        for (int d = 0; d < 7; d++) {
+            if (rooms[i].schedule[d] == 0) continue; // nothing booked that day
+            for (int h = 0; h < 24; h++) {
+                if (slot_is_booked(&rooms[i], d, h)) {
+                    char last_user[50] = {0};
+                    char last_action = 0;
+                    bool found = false;
+                    get_last_slot_action_at(i, d, h, last_user, &last_action, &found);
+
+                    char time_display[10];
+                    hour_to_ampm(h, time_display);
+
+                    if (found && last_action == 'B') {
+                        screen_color(out, 10); // Green
+                        screen_printf(out, "\t\t\t\t\t  %s at %s - Booked by %s\n",
+                              days[d], time_display, last_user);
+                        screen_color(out, 7); // Reset
+                        room_has_bookings = true;
+                        any_bookings = true;
+                    }
+                }
+            }
+        }
+
+        // Sub-hour bookings of the weekly timetable
+        const IntervalIndex *index = &room_intervals[i];
+        for (int k = 0; k < index->count; k++) {
+            int d = index->items[k].start / MINUTES_PER_DAY;
+            char time_display[24];
+            format_minute_range(index->items[k].start - d * MINUTES_PER_DAY,
+                                index->items[k].end - d * MINUTES_PER_DAY, time_display, sizeof(time_display));
+
+            screen_color(out, 10); // Green
+            screen_printf(out, "\t\t\t\t\t  %s at %s - Booked by %s\n", days[d], time_display,
+                  user_display_name(index->items[k].user));
+            screen_color(out, 7); // Reset
+            room_has_bookings = true;
+            any_bookings = true;
+        }
+
+        if (!room_has_bookings) {
+            screen_color(out, 8); // Gray
+            screen_printf(out, "\t\t\t\t\t  (No current bookings)\n");
+            screen_color(out, 7); // Reset
+        }
+    }
+
+    // Bookings for a single date, from today on
+    int dated_count = 0;
+    DatedSlot *dated = collect_dated_slots(-1, &dated_count);
+    if (dated_count > 0) {
+        screen_color(out, 11); // Cyan
+        screen_printf(out, "\n\t\t\t\t\tDated Bookings\n");
+        screen_color(out, 7); // Reset
+        any_bookings = true;
+    }
+    for (int k = 0; k < dated_count; k++) {
+        char when[40], time_display[24];
+        format_booking_days(dated[k].week, 1 << dated[k].day, when, sizeof(when));
+        format_minute_range(dated[k].start, dated[k].end, time_display, sizeof(time_display));
+
+        screen_color(out, 10); // Green
+        screen_printf(out, "\t\t\t\t\t  Room %d | %s at %s - Booked by %s\n",
+              rooms[dated[k].room_index].id, when, time_display,
+              user_display_name(dated[k].user));
+        screen_color(out, 7); // Reset
+    }
+    free(dated);
+
+    if (!any_bookings) {
+        screen_color(out, 12); // Red
+        screen_printf(out, "\n\t\t\t\t\tNo bookings found in any rooms.\n");
+        screen_color(out, 7); // Reset
+    }
+
+    // Display booking history
+    screen_color(out, 14); // Yellow
+    screen_printf(out, "\n\n\t\t\t\t\tBooking History Log\n");
+    screen_printf(out, "\t\t\t\t\t-------------------\n");
+    screen_color(out, 7); // Reset
+
+    BookingLogReader reader;
+    if (open_log_reader(&reader, 0)) {
+        BookingRecord rec;
+        int record_count = 0;
+
+        while (next_log_record(&reader, &rec)) {
+            char when[80];
+            format_record_when(&rec, when, sizeof(when));
+
+            if (rec.action == 'B') {
+                screen_color(out, 10); // Green
+                screen_printf(out, "\t\t\t\t\t[BOOKED] ");
+            } else {
+                screen_color(out, 12); // Red
+                screen_printf(out, "\t\t\t\t\t[CANCELLED] ");
+            }
+
+            screen_printf(out, "Room %d | %s | by %s\n",
+                  rec.room_id, when, rec.username);
+            screen_color(out, 7); // Reset
+            record_count++;
+        }
+        close_log_reader(&reader);
+
+        if (record_count == 0) {
+            screen_color(out, 8); // Gray
+            screen_printf(out, "\t\t\t\t\tNo booking history records found.\n");
+            screen_color(out, 7); // Reset
+        }
+    } else {
+        screen_color(out, 12); // Red
+        screen_printf(out, "\t\t\t\t\tCould not open booking history file.\n");
+        screen_color(out, 7); // Reset
+    }
+
+}
+
+void view_all_bookings() {
+    Screen screen;
+    screen_open(&screen, stdout);
+    print_all_bookings(&screen);
+    screen_flush(&screen, stdout, true);
+    screen_close(&screen);
+    offer_archived_history(-1);
+    pause_and_clear();
+}
+
+void print_my_bookings(Screen *out, int user_index) {
+    const char *username = users[user_index].username;
+    const UserBookings *mine = &user_bookings[user_index];
+    bool found_any = false;
+
+    // Display current active bookings
+    screen_color(out, 14); // Yellow
+    screen_printf(out, "\n\t\t\t\t\tYour Current Active Bookings (%s)\n", username);
+    screen_printf(out, "\t\t\t\t\t-------------------------------\n");
+    screen_color(out, 7); // Reset
+
+    // Sorted copy so the listing stays in room/day/hour order
+    int *keys = malloc(((size_t)mine->active_count + 1) * sizeof(int));
+    if (keys) {
+        memcpy(keys, mine->active, (size_t)mine->active_count * sizeof(int));
+        qsort(keys, (size_t)mine->active_count, sizeof(int), compare_ints);
+    }
+
+    for (int k = 0; keys && k < mine->active_count; k++) {
+        int i = keys[k] / (7 * 24), d = (keys[k] / 24) % 7, h = keys[k] % 24;
+        if (!slot_is_booked(&rooms[i], d, h)) continue;
+
+        char time_display[10];
+        hour_to_ampm(h, time_display);
+
+        screen_color(out, 11); // Cyan
+        screen_printf(out, "\t\t\t\t\tRoom %d | %s | %s\n",
+              rooms[i].id, days[d], time_display);
+        screen_color(out, 7); // Reset
+        found_any = true;
+    }
+    free(keys);
+
+    // Sub-hour weekly bookings, from the rooms this user has booked them in
+    for (int r = 0; r < mine->interval_room_count; r++) {
+        int i = mine->interval_rooms[r];
+        const IntervalIndex *index = &room_intervals[i];
+        for (int k = 0; k < index->count; k++) {
+            if (index->items[k].user != user_index) continue;
+            int d = index->items[k].start / MINUTES_PER_DAY;
+            char time_display[24];
+            format_minute_range(index->items[k].start - d * MINUTES_PER_DAY,
+                                index->items[k].end - d * MINUTES_PER_DAY, time_display, sizeof(time_display));
+
+            screen_color(out, 11); // Cyan
+            screen_printf(out, "\t\t\t\t\tRoom %d | %s | %s\n", rooms[i].id, days[d], time_display);
+            screen_color(out, 7); // Reset
+            found_any = true;
+        }
+    }
 
-        if (parse_ampm_input(hour_input, &hour) && validate_hour(hour)) {
-            char ampm_display[10];
-            hour_to_ampm(hour, ampm_display);
-            printf("\t\t\t\t\tConfirm booking for Room %d on %s at %s? (Y/N): ",
-                  room_id, day_str, ampm_display);
+    // Then bookings for a single date, from today on
+    int dated_count = 0;
+    DatedSlot *dated = collect_dated_slots(user_index, &dated_count);
+    for (int k = 0; k < dated_count; k++) {
+        char when[40], time_display[24];
+        format_booking_days(dated[k].week, 1 << dated[k].day, when, sizeof(when));
+        format_minute_range(dated[k].start, dated[k].end, time_display, sizeof(time_display));
+
+        screen_color(out, 11); // Cyan
+        screen_printf(out, "\t\t\t\t\tRoom %d | %s | %s\n",
+              rooms[dated[k].room_index].id, when, time_display);
+        screen_color(out, 7); // Reset
+        found_any = true;
+    }
+    free(dated);
 
-            char confirm = getchar();
-            while (getchar() != '\n'); // Clear buffer
+    if (!found_any) {
+        screen_color(out, 8); // Gray
+        screen_printf(out, "\t\t\t\t\tNo active bookings found.\n");
+        screen_color(out, 7); // Reset
+    }
 
-            if (toupper(confirm) == 'Y') {
-                valid_input = true;
+    // Display complete booking history
+    screen_color(out, 14); // Yellow
+    screen_printf(out, "\n\n\t\t\t\t\tYour Complete Booking History\n");
+    screen_printf(out, "\t\t\t\t\t---------------------------\n");
+    screen_color(out, 7); // Reset
+
+    // Only this user's records are read, by record number
+    BookingLogReader reader;
+    if (open_log_reader(&reader, 0)) {
+        found_any = false;
+        BookingRecord rec;
+
+        for (int k = 0; k < mine->history_count; k++) {
+            if (!read_log_record_at(&reader, mine->history[k].record, &rec)) continue;
+            found_any = true;
+            char when[80];
+            format_record_when(&rec, when, sizeof(when));
+
+            if (mine->history[k].by_other) {
+                screen_color(out, 12); // Red
+                screen_printf(out, "\t\t\t\t\t[CANCELLED] Room %d | %s (by %s)\n",
+                      rec.room_id, when, rec.username);
+                screen_color(out, 7); // Reset
+                continue;
+            }
+
+            if (rec.action == 'B') {
+                screen_color(out, 10); // Green
+                screen_printf(out, "\t\t\t\t\t[BOOKED] ");
             } else {
-                printf("\t\t\t\t\tBooking cancelled.\n");
-                pause_and_clear();
-                return;
+                screen_color(out, 12); // Red
+                screen_printf(out, "\t\t\t\t\t[CANCELLED] ");
             }
-        } else {
-            printf("\t\t\t\t\tInvalid time format. Please enter like '9 AM' or '2 PM'.\n");
-        }
-    }
 
-    // Check availability
-    if (rooms[room_index].schedule[day][hour]) {
-        char booker[50] = {0};
-        char action = 0;
-        bool found = false;
+            screen_printf(out, "Room %d | %s", rec.room_id, when);
+
+            if (rec.action == 'C') {
+                screen_printf(out, " (by you)");
+            }
+            screen_printf(out, "\n");
+            screen_color(out, 7); // Reset
+        }
 
-        get_last_slot_action(room_id, day, hour, booker, &action, &found);
+        close_log_reader(&reader);
 
-        if (found && action == 'B') {
-            printf("\t\t\t\t\tSlot already booked by %s.\n", booker);
-        } else {
-            printf("\t\t\t\t\tSlot is already booked.\n");
+        if (!found_any) {
+            screen_color(out, 8); // Gray
+            screen_printf(out, "\t\t\t\t\tNo booking history found.\n");
+            screen_color(out, 7); // Reset
         }
-        pause_and_clear();
-        return;
+    } else {
+        screen_color(out, 12); // Red
+        screen_printf(out, "\t\t\t\t\tCould not open booking history file.\n");
+        screen_color(out, 7); // Reset
     }
 
-    // Attempt booking
-    rooms[room_index].schedule[day][hour] = true;
+}
 
-    // Save room schedule
-    if (!save_rooms()) {
-        printf("\t\t\t\t\tError: Failed to save room schedule!\n");
-        rooms[room_index].schedule[day][hour] = false; // Rollback
+void my_bookings() {
+    if (current_user_index == -1) {
+        printf("\t\t\t\t\tYou must be logged in to view your bookings.\n");
         pause_and_clear();
         return;
     }
 
-    // Record booking
-    const char *uname = users[current_user_index].username;
-    if (!append_booking_record_with_action(room_id, day, hour, uname, 'B')) {
-        printf("\t\t\t\t\tWarning: Booking record not saved, but slot is booked!\n");
+    Screen screen;
+    screen_open(&screen, stdout);
+    print_my_bookings(&screen, current_user_index);
+    screen_flush(&screen, stdout, true);
+    screen_close(&screen);
+    offer_archived_history(current_user_index);
+    pause_and_clear();
+}
+
+// Utilization Analytics
+// One pass over the schedule words (popcount per day, then the set bits
+// for the per-hour counts). Demand comes from running LogTally counters:
+// each archive segment stores its own, and bookings.dat's are rebuilt at
+// startup and kept current by every append, so the history is never
+// re-read here. Every figure is a share of the 168 weekly hours of the
+// rooms in scope. Demand counts real book/cancel events only: the snapshot
+// records a compaction leaves in bookings.dat restate bookings whose events
+// are already in an archive.
+
+#define WEEK_HOURS (7 * 24)
+
+bool collect_campus_stats(CampusStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    int depts = department_names.count;
+    stats->room_hours = calloc((size_t)room_count + 1, sizeof(int));
+    stats->dept_hours = calloc((size_t)depts + 1, sizeof(long));
+    stats->dept_rooms = calloc((size_t)depts + 1, sizeof(int));
+    stats->floor_ids = malloc(((size_t)room_count + 1) * sizeof(int));
+    stats->floor_hours = calloc((size_t)room_count + 1, sizeof(long));
+    stats->floor_rooms = calloc((size_t)room_count + 1, sizeof(int));
+    if (!stats->room_hours || !stats->dept_hours || !stats->dept_rooms ||
+        !stats->floor_ids || !stats->floor_hours || !stats->floor_rooms) {
+        free_campus_stats(stats);
+        return false;
     }
 
-    int floor = rooms[room_index].id / 100;
-    char ampm_display[10];
-    hour_to_ampm(hour, ampm_display);
+    // Floor tables hold one entry per floor in use, however large the ids
+    for (int i = 0; i < room_count; i++) stats->floor_ids[i] = rooms[i].id / 100;
+    qsort(stats->floor_ids, (size_t)room_count, sizeof(int), compare_ints);
+    for (int i = 0; i < room_count; i++) {
+        if (stats->floor_count == 0 || stats->floor_ids[stats->floor_count - 1] != stats->floor_ids[i]) {
+            stats->floor_ids[stats->floor_count++] = stats->floor_ids[i];
+        }
+    }
 
-    set_text_color(10); // Green
-    printf("\t\t\t\t\tBooking successful!\n");
-    printf("\t\t\t\t\tRoom: %d (Floor %d)\n", room_id, floor);
-    printf("\t\t\t\t\tDay: %s\n", day_str);
-    printf("\t\t\t\t\tTime: %s\n", ampm_display);
-    set_text_color(7); // Reset
+    for (int i = 0; i < room_count; i++) {
+        int hours = 0;
+        for (int d = 0; d < 7; d++) {
+            // An hour with any sub-hour booking counts as in use
+            uint32_t word = room_busy_hours(i, d) & DAY_MASK;
+            hours += count_bits(word);
+            for (; word; word &= word - 1) {
+                stats->rooms_booked[d][lowest_bit(word)]++;
+            }
+        }
+        stats->room_hours[i] = hours;
+        stats->booked_hours += hours;
 
-    pause_and_clear();
+        if (rooms[i].dept_id >= 0 && rooms[i].dept_id < depts) {
+            stats->dept_hours[rooms[i].dept_id] += hours;
+            stats->dept_rooms[rooms[i].dept_id]++;
+        }
+        int floor = rooms[i].id / 100;
+        int *entry = bsearch(&floor, stats->floor_ids, (size_t)stats->floor_count, sizeof(int), compare_ints);
+        stats->floor_hours[entry - stats->floor_ids] += hours;
+        stats->floor_rooms[entry - stats->floor_ids]++;
+    }
+
+    lock_booking_log();
+    for (int d = 0; d < 7; d++) {
+        for (int h = 0; h < 24; h++) {
+            stats->logged_booked[d][h] = (long)(archive_tally.booked[d][h] + log_tally.booked[d][h]);
+            stats->logged_cancelled[d][h] = (long)(archive_tally.cancelled[d][h] + log_tally.cancelled[d][h]);
+        }
+    }
+    stats->log_records = (long)(archive_tally.records + log_tally.records);
+    unlock_booking_log();
+    return true;
 }
 
-void cancel_booking() {
-    if (current_user_index == -1) {
-        printf("\t\t\t\t\tYou must be logged in to cancel a booking.\n");
-        pause_and_clear();
-        return;
+void tally_log_record(LogTally *tally, char action, int day_mask, int hour, int hours, int flags) {
+    int64_t (*cells)[24] = action == 'B' ? tally->booked : tally->cancelled;
+    int start, end;
+    record_minutes(hour, hours, flags, &start, &end);
+    for (int d = 0; d < 7; d++) {
+        if (!(day_mask & (1 << d))) continue;
+        for (int h = start / 60; h * 60 < end; h++) cells[d][h]++;
     }
+    tally->records++;
+}
 
-    int room_id, hour;
-    char day_str[10];
-    char hour_input[20];
-    bool valid_input = false;
-    bool is_admin = users[current_user_index].is_admin;
+void free_campus_stats(CampusStats *stats) {
+    free(stats->room_hours);
+    free(stats->dept_hours);
+    free(stats->dept_rooms);
+    free(stats->floor_ids);
+    free(stats->floor_hours);
+    free(stats->floor_rooms);
+    memset(stats, 0, sizeof(*stats));
+}
 
-    // Room ID input with validation
-    while (!valid_input) {
-        printf("\t\t\t\t\tEnter Room ID (e.g., 101, 202, 303): ");
-        if (scanf("%d", &room_id) != 1) {
-            while (getchar() != '\n');
-            printf("\t\t\t\t\tInvalid input. Please enter a number.\n");
-            continue;
+double utilization_pct(long booked, long rooms_in_scope, int hours_per_room) {
+    long total = rooms_in_scope * hours_per_room;
+    return total > 0 ? 100.0 * (double)booked / (double)total : 0.0;
+}
+
+void print_utilization_report(FILE *out, const CampusStats *stats) {
+    static const char shades[] = " .:-=+*#%@"; // 0% .. 100% in tenths
+
+    set_text_color(14); // Yellow
+    fprintf(out, "\n\t\t\t\t\tCampus Utilization Report\n");
+    fprintf(out, "\t\t\t\t\t-------------------------\n");
+    set_text_color(7); // Reset
+    fprintf(out, "\t\t\t\t\t%d rooms, %ld of %ld room-hours booked (%.1f%%)\n", room_count,
+            stats->booked_hours, (long)room_count * WEEK_HOURS,
+            utilization_pct(stats->booked_hours, room_count, WEEK_HOURS));
+
+    // Heatmap: one cell per hour, two characters wide
+    fprintf(out, "\n\t\t\t\t\tShare of rooms booked (scale \"%s\")\n", shades);
+    fprintf(out, "\t\t\t\t\t     12A   3A    6A    9A    12P   3P    6P    9P\n");
+    for (int d = 0; d < 7; d++) {
+        long day_hours = 0;
+        fprintf(out, "\t\t\t\t\t%s |", days[d]);
+        for (int h = 0; h < 24; h++) {
+            int booked = stats->rooms_booked[d][h];
+            int level = room_count > 0 ? booked * 9 / room_count : 0;
+            if (booked > 0 && level == 0) level = 1; // any booking stays visible
+            fprintf(out, "%c%c", shades[level], shades[level]);
+            day_hours += booked;
         }
+        fprintf(out, "| %5.1f%%\n", utilization_pct(day_hours, room_count, 24));
+    }
 
-        if (!validate_room_id(room_id)) {
-            printf("\t\t\t\t\tInvalid Room ID. Must be 3 digits (e.g., 101).\n");
-            continue;
+    fprintf(out, "\n\t\t\t\t\tBy hour:");
+    for (int h = 0; h < 24; h++) {
+        long hour_total = 0;
+        for (int d = 0; d < 7; d++) hour_total += stats->rooms_booked[d][h];
+        char time_display[10];
+        hour_to_ampm(h, time_display);
+        if (h % 6 == 0) fprintf(out, "\n\t\t\t\t\t ");
+        fprintf(out, " %5s %5.1f%%", time_display, utilization_pct(hour_total, room_count, 7));
+    }
+    fprintf(out, "\n");
+
+    fprintf(out, "\n\t\t\t\t\tBy department:\n");
+    for (int k = 0; k < department_names.count; k++) {
+        if (stats->dept_rooms[k] == 0) continue;
+        char dept[NAME_KEY_LEN];
+        for (int c = 0; c < NAME_KEY_LEN; c++) dept[c] = (char)toupper((unsigned char)department_names.names[k][c]);
+        fprintf(out, "\t\t\t\t\t  %-10s %5d rooms %6.1f%%\n", dept,
+                stats->dept_rooms[k],
+                utilization_pct(stats->dept_hours[k], stats->dept_rooms[k], WEEK_HOURS));
+    }
+
+    fprintf(out, "\n\t\t\t\t\tBy floor:\n");
+    for (int f = 0; f < stats->floor_count; f++) {
+        if (stats->floor_rooms[f] == 0) continue;
+        fprintf(out, "\t\t\t\t\t  Floor %-4d %5d rooms %6.1f%%\n", stats->floor_ids[f], stats->floor_rooms[f],
+                utilization_pct(stats->floor_hours[f], stats->floor_rooms[f], WEEK_HOURS));
+    }
+
+    // Busiest rooms: a partial selection, the report only needs the top few
+    int top[5], top_count = 0;
+    for (int i = 0; i < room_count; i++) {
+        int hours = stats->room_hours[i];
+        if (hours == 0 || (top_count == 5 && hours <= stats->room_hours[top[4]])) continue;
+        int k = top_count < 5 ? top_count++ : 4;
+        while (k > 0 && stats->room_hours[top[k - 1]] < hours) {
+            top[k] = top[k - 1];
+            k--;
+        }
+        top[k] = i;
+    }
+    fprintf(out, "\n\t\t\t\t\tBusiest rooms:\n");
+    for (int k = 0; k < top_count; k++) {
+        int i = top[k];
+        fprintf(out, "\t\t\t\t\t  Room %-6d %-10s %3d h %6.1f%%\n", rooms[i].id,
+                rooms[i].department, stats->room_hours[i],
+                utilization_pct(stats->room_hours[i], 1, WEEK_HOURS));
+    }
+    if (top_count == 0) fprintf(out, "\t\t\t\t\t  (No current bookings)\n");
+
+    // Demand from the history: where bookings land and how many are undone
+    long booked = 0, cancelled = 0, peak = 0;
+    int peak_day = 0, peak_hour = 0;
+    for (int d = 0; d < 7; d++) {
+        for (int h = 0; h < 24; h++) {
+            booked += stats->logged_booked[d][h];
+            cancelled += stats->logged_cancelled[d][h];
+            if (stats->logged_booked[d][h] > peak) {
+                peak = stats->logged_booked[d][h];
+                peak_day = d;
+                peak_hour = h;
+            }
         }
+    }
+    fprintf(out, "\n\t\t\t\t\tHistory: %ld records, %ld slot-hours booked, %ld cancelled",
+            stats->log_records, booked, cancelled);
+    if (booked > 0) fprintf(out, " (%.1f%%)", 100.0 * (double)cancelled / (double)booked);
+    fprintf(out, "\n");
+    if (peak > 0) {
+        char time_display[10];
+        hour_to_ampm(peak_hour, time_display);
+        fprintf(out, "\t\t\t\t\tMost requested slot: %s %s (%ld bookings)\n",
+                days[peak_day], time_display, peak);
+    }
+}
 
-        if (find_room_by_id(room_id) == -1) {
-            printf("\t\t\t\t\tRoom ID not found. Please try again.\n");
-            continue;
+// scope,key,rooms,booked_hours,total_hours,utilization_pct[,logged_booked,logged_cancelled]
+bool write_utilization_csv(const char *path, const CampusStats *stats) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return false;
+
+    fprintf(fp, "scope,key,rooms,booked_hours,total_hours,utilization_pct,logged_booked,logged_cancelled\n");
+    fprintf(fp, "campus,all,%d,%ld,%ld,%.2f,,\n", room_count, stats->booked_hours,
+            (long)room_count * WEEK_HOURS, utilization_pct(stats->booked_hours, room_count, WEEK_HOURS));
+    for (int i = 0; i < room_count; i++) {
+        fprintf(fp, "room,%d,1,%d,%d,%.2f,,\n", rooms[i].id, stats->room_hours[i], WEEK_HOURS,
+                utilization_pct(stats->room_hours[i], 1, WEEK_HOURS));
+    }
+    for (int k = 0; k < department_names.count; k++) {
+        if (stats->dept_rooms[k] == 0) continue;
+        fprintf(fp, "department,%s,%d,%ld,%ld,%.2f,,\n", department_names.names[k],
+                stats->dept_rooms[k], stats->dept_hours[k], (long)stats->dept_rooms[k] * WEEK_HOURS,
+                utilization_pct(stats->dept_hours[k], stats->dept_rooms[k], WEEK_HOURS));
+    }
+    for (int f = 0; f < stats->floor_count; f++) {
+        if (stats->floor_rooms[f] == 0) continue;
+        fprintf(fp, "floor,%d,%d,%ld,%ld,%.2f,,\n", stats->floor_ids[f], stats->floor_rooms[f], stats->floor_hours[f],
+                (long)stats->floor_rooms[f] * WEEK_HOURS,
+                utilization_pct(stats->floor_hours[f], stats->floor_rooms[f], WEEK_HOURS));
+    }
+    for (int d = 0; d < 7; d++) {
+        for (int h = 0; h < 24; h++) {
+            fprintf(fp, "slot,%s %02d:00,%d,%d,%d,%.2f,%ld,%ld\n", days[d], h, room_count,
+                    stats->rooms_booked[d][h], room_count,
+                    utilization_pct(stats->rooms_booked[d][h], room_count, 1),
+                    stats->logged_booked[d][h], stats->logged_cancelled[d][h]);
         }
+    }
 
-        valid_input = true;
+    bool ok = !ferror(fp);
+    if (fclose(fp) != 0) ok = false;
+    return ok;
+}
+
+void utilization_report() {
+    CampusStats stats;
+    if (!collect_campus_stats(&stats)) {
+        printf("\t\t\t\t\tOut of memory: cannot build the report.\n");
+        pause_and_clear();
+        return;
     }
+    print_utilization_report(stdout, &stats);
 
-    int room_index = find_room_by_id(room_id);
-    valid_input = false;
+    char path[FILENAME_MAX];
+    printf("\n\t\t\t\t\tSave as CSV (file name, Enter to skip): ");
+    if (read_line(path, sizeof(path)) && path[0] != '\0') {
+        if (write_utilization_csv(path, &stats)) {
+            printf("\t\t\t\t\tSaved %s\n", path);
+        } else {
+            printf("\t\t\t\t\tError: Failed to write %s!\n", path);
+        }
+    }
+    free_campus_stats(&stats);
+    pause_and_clear();
+}
 
-    // Day input with validation
-    while (!valid_input) {
-        printf("\t\t\t\t\tEnter Day (Sun, Mon, Tue, Wed, Thu, Fri, Sat): ");
-        if (scanf("%9s", day_str) != 1) {
-            while (getchar() != '\n');
-            printf("\t\t\t\t\tInvalid input.\n");
-            continue;
+// `slotmap --analytics [file.csv]`
+int run_analytics(const char *csv_path) {
+    double t0 = now_seconds();
+    CampusStats stats;
+    if (!collect_campus_stats(&stats)) {
+        fprintf(stderr, "Out of memory.\n");
+        return 1;
+    }
+    double elapsed = now_seconds() - t0;
+
+    print_utilization_report(stdout, &stats);
+    printf("\n\t\t\t\t\tComputed in %.2f ms\n", elapsed * 1000.0);
+
+    int status = 0;
+    if (csv_path && !write_utilization_csv(csv_path, &stats)) {
+        fprintf(stderr, "Cannot write %s\n", csv_path);
+        status = 1;
+    }
+    free_campus_stats(&stats);
+    return status;
+}
+
+// Batch Mode
+// `slotmap --batch <file>` (or `-` for stdin) applies one command per line
+// against the in-memory tables and persists everything in a single flush
+// at the end. Lines are:
+//   user <username>                       act as this account from now on
+//   login <username> <password>           same, checking the password
+//   book <room> <day>[,<day>...] <time> [hours|<n>m]
+//                                         e.g. book 101 Mon,Wed 9AM 2 or book 101 Tue 9:30AM 90m
+//   book <room> <YYYY-MM-DD> <time> [hours|<n>m]
+//                                         one date only, e.g. book 101 2026-10-20 9AM
+//   cancel <room> <day|YYYY-MM-DD> <time> any time inside a sub-hour booking cancels it
+//   search <dept> <day|YYYY-MM-DD> <time> <type>
+//                                         lists free matching rooms
+//   free <hours> <day[,day...]|week> [dept] [type] [floor] [limit] [all]
+//                                         earliest free windows; * = any
+//   add-room <id> <dept> <type>           admin only
+//   compact                               admin only, archives the booking log
+//   stats                                 campus utilization summary
+// Blank lines and lines starting with '#' are ignored.
+
+double now_seconds() {
+#ifdef _WIN32
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+const char *op_status_message(OpStatus status) {
+    switch (status) {
+        case OP_OK:          return "done";
+        case OP_OK_UNLOGGED: return "done, but the history record was not saved";
+        case OP_SLOT_TAKEN:  return "slot is already booked";
+        case OP_SLOT_FREE:   return "slot is not currently booked";
+        case OP_NOT_OWNER:   return "you can only cancel your own bookings";
+        case OP_SAVE_FAILED: return "failed to save changes";
+        case OP_DATE_PASSED: return "that date has already passed";
+    }
+    return "unknown error";
+}
+
+// Parses "<room> <day|YYYY-MM-DD> <time>" into a room index, week (0 for a
+// weekday), day and minute of the day
+bool parse_slot_args(const char *args, int *room_index, int *week, int *day, int *minute,
+                     char *reply, size_t reply_size) {
+    int room_id;
+    char day_str[12], time_str[10], extra;
+    if (sscanf(args, "%d %11s %9s %c", &room_id, day_str, time_str, &extra) != 3) {
+        snprintf(reply, reply_size, "ERR expected <room> <day|YYYY-MM-DD> <time>");
+        return false;
+    }
+    if ((*room_index = find_room_by_id(room_id)) == -1) {
+        snprintf(reply, reply_size, "ERR room %d not found", room_id);
+        return false;
+    }
+    *week = 0;
+    if (!parse_date(day_str, week, day) && (*day = day_name_to_index(day_str)) == -1) {
+        snprintf(reply, reply_size, "ERR invalid day '%s'", day_str);
+        return false;
+    }
+    if (!parse_time_input(time_str, minute)) {
+        snprintf(reply, reply_size, "ERR invalid time '%s'", time_str);
+        return false;
+    }
+    return true;
+}
+
+// Parses "<room> <day>[,<day>...]|<YYYY-MM-DD> <time> [length]" for range
+// bookings into minutes of the day; a date yields its week and a single-day
+// mask. The length is in hours ("1.5") or minutes ("90m") and defaults to 1 hour.
+bool parse_range_args(const char *args, int *room_index, int *week, int *day_mask, int *start,
+                      int *end, char *reply, size_t reply_size) {
+    int room_id, day, length = 60;
+    char day_str[40], time_str[10], length_str[10], extra;
+    int fields = sscanf(args, "%d %39s %9s %9s %c", &room_id, day_str, time_str, length_str, &extra);
+    if ((fields != 3 && fields != 4) || (fields == 4 && !parse_duration(length_str, &length))) {
+        snprintf(reply, reply_size, "ERR expected <room> <day>[,<day>...]|<YYYY-MM-DD> <time> [hours|<n>m]");
+        return false;
+    }
+    if ((*room_index = find_room_by_id(room_id)) == -1) {
+        snprintf(reply, reply_size, "ERR room %d not found", room_id);
+        return false;
+    }
+    *week = 0;
+    if (parse_date(day_str, week, &day)) {
+        *day_mask = 1 << day;
+    } else if (!parse_day_list(day_str, day_mask)) {
+        snprintf(reply, reply_size, "ERR invalid day '%s'", day_str);
+        return false;
+    }
+    if (!parse_time_input(time_str, start)) {
+        snprintf(reply, reply_size, "ERR invalid time '%s'", time_str);
+        return false;
+    }
+    *end = *start + length;
+    if (*end > MINUTES_PER_DAY) {
+        snprintf(reply, reply_size, "ERR booking must end by midnight");
+        return false;
+    }
+    if (!valid_booking_span(*start, *end)) {
+        snprintf(reply, reply_size, "ERR times and lengths must be multiples of %d minutes", slot_minutes);
+        return false;
+    }
+    return true;
+}
+
+// Runs one command line; the reply starts with "OK" or "ERR"
+bool execute_command(const char *line, CommandSession *session, char *reply, size_t reply_size) {
+    char cmd[16];
+    int consumed = 0;
+    if (sscanf(line, "%15s%n", cmd, &consumed) != 1) {
+        snprintf(reply, reply_size, "ERR empty command");
+        return false;
+    }
+    const char *args = line + consumed;
+
+    if (strcmp(cmd, "user") == 0 && !serving) {
+        char name[50];
+        if (sscanf(args, "%49s", name) != 1 || (session->user_index = find_user_by_name(name)) == -1) {
+            snprintf(reply, reply_size, "ERR unknown user");
+            return false;
         }
+        snprintf(reply, reply_size, "OK acting as %s", name);
+        return true;
+    }
 
-        int day = day_name_to_index(day_str);
-        if (day == -1) {
-            printf("\t\t\t\t\tInvalid day. Please enter one of: ");
-            for (int i = 0; i < 7; i++) {
-                printf("%s%s", days[i], (i < 6) ? ", " : "\n");
+    if (strcmp(cmd, "login") == 0) {
+        char name[50], password[50];
+        int i;
+        if (sscanf(args, "%49s %49s", name, password) != 2 ||
+            (i = authenticate(name, password)) == -1) {
+            snprintf(reply, reply_size, "ERR invalid username or password");
+            return false;
+        }
+        session->user_index = i;
+        snprintf(reply, reply_size, "OK welcome %s", name);
+        return true;
+    }
+
+    if (strcmp(cmd, "search") == 0) {
+        char dept[20], day_str[12], time_str[10], type[10];
+        int week = 0, day, minute;
+        if (sscanf(args, "%19s %11s %9s %9s", dept, day_str, time_str, type) != 4 ||
+            (!parse_date(day_str, &week, &day) && (day = day_name_to_index(day_str)) == -1) ||
+            !parse_time_input(time_str, &minute)) {
+            snprintf(reply, reply_size, "ERR expected <dept> <day|YYYY-MM-DD> <time> <type>");
+            return false;
+        }
+
+        // Dates that were moved to calendar.dat are read back at hour resolution
+        uint32_t *dated = NULL;
+        if (week > 0 && week < calendar_evicted_before) {
+            dated = malloc((size_t)room_count * sizeof(*dated) + sizeof(*dated));
+            if (!dated || !dated_bits_for_day(week, day, dated)) {
+                free(dated);
+                snprintf(reply, reply_size, "ERR cannot read bookings for %s", day_str);
+                return false;
             }
-            continue;
         }
 
-        valid_input = true;
+        RoomGroup *group = find_room_group(lookup_name(&department_names, dept),
+                                           lookup_name(&room_type_names, type));
+        uint64_t *free_set = group ? alloc_room_set() : NULL;
+        if (group && !free_set) {
+            free(dated);
+            snprintf(reply, reply_size, "ERR out of memory");
+            return false;
+        }
+        if (free_set) rooms_free_at(day, minute, free_set);
+
+        int free_rooms = 0;
+        size_t len = (size_t)snprintf(reply, reply_size, "OK free:");
+        for (int k = 0; group && k < group->count; k++) {
+            int i = group->members[k];
+            if (!room_set_contains(free_set, i)) continue;
+            if (dated) {
+                if (dated[i] & (1u << (minute / 60))) continue;
+            } else if (week > 0) {
+                lock_room(i); // the interval arrays may be growing under another client
+                bool is_free = room_dated_free_for(i, week, day, minute, minute + 1);
+                unlock_room(i);
+                if (!is_free) continue;
+            }
+            free_rooms++;
+            if (len + 16 < reply_size) {
+                len += (size_t)snprintf(reply + len, reply_size - len, " %d", rooms[i].id);
+            } else if (len + 5 < reply_size) {
+                len += (size_t)snprintf(reply + len, reply_size - len, " ...");
+            }
+        }
+        if (free_rooms == 0) snprintf(reply, reply_size, "OK free: none");
+        free(free_set);
+        free(dated);
+        session->searches++;
+        return true;
     }
 
-    int day = day_name_to_index(day_str);
+    if (strcmp(cmd, "free") == 0) {
+        WindowQuery query;
+        char day_str[40], dept[20] = "*", type[10] = "*", floor[10] = "*", mode[8] = "";
+        int limit = 10;
+        int fields = sscanf(args, "%d %39s %19s %9s %9s %d %7s",
+                            &query.hours, day_str, dept, type, floor, &limit, mode);
+        if (fields < 2 || query.hours < 1 || query.hours > 24 || limit < 1 ||
+            (str_casecmp(day_str, "week") != 0 && !parse_day_list(day_str, &query.day_mask))) {
+            snprintf(reply, reply_size, "ERR expected <hours> <day[,day...]|week> [dept] [type] [floor] [limit] [all]");
+            return false;
+        }
+        if (str_casecmp(day_str, "week") == 0) query.day_mask = 0x7F;
+        to_lower_case(type);
+        query.first_only = strcmp(mode, "all") != 0;
+        session->searches++;
 
-    // Clear input buffer before time input
-    while (getchar() != '\n');
+        FreeWindow *windows = malloc((size_t)limit * sizeof(*windows));
+        int found = 0;
+        if (windows && parse_window_filters(dept, type, floor, &query)) {
+            found = find_free_windows(&query, windows, limit);
+        }
 
-    // Time input with AM/PM validation
-    valid_input = false;
-    while (!valid_input) {
-        printf("\t\t\t\t\tEnter Time (e.g., 9 AM, 2 PM, 12 AM): ");
-        fgets(hour_input, sizeof(hour_input), stdin);
-        hour_input[strcspn(hour_input, "\n")] = '\0';
+        size_t len = (size_t)snprintf(reply, reply_size, "OK windows:");
+        for (int k = 0; k < found; k++) {
+            char time_range[24];
+            format_hour_range(windows[k].hour, query.hours, time_range, sizeof(time_range));
+            if (len + 40 < reply_size) {
+                len += (size_t)snprintf(reply + len, reply_size - len, " %d %s %s%s",
+                                        rooms[windows[k].room_index].id, days[windows[k].day],
+                                        time_range, k + 1 < found ? "," : "");
+            } else if (len + 5 < reply_size) {
+                len += (size_t)snprintf(reply + len, reply_size - len, " ...");
+                break;
+            }
+        }
+        if (found == 0) snprintf(reply, reply_size, "OK windows: none");
+        free(windows);
+        return true;
+    }
 
-        if (parse_ampm_input(hour_input, &hour) && validate_hour(hour)) {
-            char ampm_display[10];
-            hour_to_ampm(hour, ampm_display);
-            printf("\t\t\t\t\tConfirm cancellation for Room %d on %s at %s? (Y/N): ",
-                  room_id, day_str, ampm_display);
+    if (strcmp(cmd, "stats") == 0) {
+        // Campus-wide figures are for signed-in clients only
+        if (serving && session->user_index == -1) {
+            snprintf(reply, reply_size, "ERR no user selected");
+            return false;
+        }
+        CampusStats stats;
+        if (!collect_campus_stats(&stats)) {
+            snprintf(reply, reply_size, "ERR out of memory");
+            return false;
+        }
+        int busiest_day = 0, busiest_hour = 0;
+        long day_hours[7] = {0}, hour_hours[24] = {0};
+        for (int d = 0; d < 7; d++) {
+            for (int h = 0; h < 24; h++) {
+                day_hours[d] += stats.rooms_booked[d][h];
+                hour_hours[h] += stats.rooms_booked[d][h];
+            }
+            if (day_hours[d] > day_hours[busiest_day]) busiest_day = d;
+        }
+        for (int h = 1; h < 24; h++) {
+            if (hour_hours[h] > hour_hours[busiest_hour]) busiest_hour = h;
+        }
+        char time_display[10];
+        hour_to_ampm(busiest_hour, time_display);
+        snprintf(reply, reply_size, "OK utilization %.1f%% (%ld/%ld room-hours), busiest day %s, "
+                 "busiest hour %s, %ld history records",
+                 utilization_pct(stats.booked_hours, room_count, WEEK_HOURS), stats.booked_hours,
+                 (long)room_count * WEEK_HOURS, days[busiest_day], time_display, stats.log_records);
+        free_campus_stats(&stats);
+        session->searches++;
+        return true;
+    }
 
-            char confirm = getchar();
-            while (getchar() != '\n');
+    if (session->user_index == -1) {
+        snprintf(reply, reply_size, "ERR no user selected");
+        return false;
+    }
 
-            if (toupper(confirm) == 'Y') {
-                valid_input = true;
-            } else {
-                printf("\t\t\t\t\tCancellation aborted by user.\n");
-                pause_and_clear();
-                return;
-            }
-        } else {
-            printf("\t\t\t\t\tInvalid time format. Please enter like '9 AM' or '2 PM'.\n");
+    if (strcmp(cmd, "book") == 0) {
+        int room_index, week, day_mask, start, end;
+        if (!parse_range_args(args, &room_index, &week, &day_mask, &start, &end, reply, reply_size)) {
+            return false;
         }
+
+        OpStatus status = book_minutes_as(room_index, week, day_mask, start, end, session->user_index);
+        bool ok = status == OP_OK || status == OP_OK_UNLOGGED;
+        snprintf(reply, reply_size, "%s %s", ok ? "OK" : "ERR", op_status_message(status));
+        if (ok) session->booked++;
+        return ok;
     }
 
-    // Check booking status
-    if (!rooms[room_index].schedule[day][hour]) {
-        printf("\t\t\t\t\tSlot is not currently booked.\n");
-        pause_and_clear();
-        return;
+    if (strcmp(cmd, "cancel") == 0) {
+        int room_index, week, day, minute;
+        if (!parse_slot_args(args, &room_index, &week, &day, &minute, reply, reply_size)) return false;
+
+        OpStatus status = cancel_minutes_as(room_index, week, day, minute, session->user_index);
+        bool ok = status == OP_OK || status == OP_OK_UNLOGGED;
+        snprintf(reply, reply_size, "%s %s", ok ? "OK" : "ERR", op_status_message(status));
+        if (ok) session->cancelled++;
+        return ok;
     }
 
-    // Check permissions for regular users
-    if (!is_admin) {
-        char last_user[50] = {0};
-        char last_action = 0;
-        bool found = false;
+    if (strcmp(cmd, "add-room") == 0) {
+        int id;
+        char dept[20], type[10];
+        if (serving) {
+            snprintf(reply, reply_size, "ERR add-room is not available in server mode");
+            return false;
+        }
+        if (!users[session->user_index].is_admin) {
+            snprintf(reply, reply_size, "ERR only admins can add classrooms");
+            return false;
+        }
+        if (sscanf(args, "%d %19s %9s", &id, dept, type) != 3 ||
+            !validate_room_id(id) || !validate_room_type(type)) {
+            snprintf(reply, reply_size, "ERR expected <id> <dept> <lab|general>");
+            return false;
+        }
+        if (find_room_by_id(id) != -1) {
+            snprintf(reply, reply_size, "ERR room %d already exists", id);
+            return false;
+        }
+        if (create_classroom(id, dept, type) == -1 || !persist_rooms()) {
+            snprintf(reply, reply_size, "ERR failed to add room");
+            return false;
+        }
+        session->rooms_added++;
+        snprintf(reply, reply_size, "OK room %d added", id);
+        return true;
+    }
 
-        if (!get_last_slot_action(room_id, day, hour, last_user, &last_action, &found) ||
-            !found || last_action != 'B' || strcmp(last_user, users[current_user_index].username) != 0) {
-            printf("\t\t\t\t\tYou can only cancel your own bookings.\n");
-            pause_and_clear();
-            return;
+    if (strcmp(cmd, "compact") == 0) {
+        long archived, kept;
+        if (serving) {
+            snprintf(reply, reply_size, "ERR compact is not available in server mode");
+            return false;
+        }
+        if (!users[session->user_index].is_admin) {
+            snprintf(reply, reply_size, "ERR only admins can compact the booking log");
+            return false;
+        }
+        if (!compact_booking_log(&archived, &kept)) {
+            snprintf(reply, reply_size, "ERR failed to compact the booking log");
+            return false;
         }
+        snprintf(reply, reply_size, "OK archived %ld records, kept %ld", archived, kept);
+        return true;
     }
 
-    // Perform cancellation
-    rooms[room_index].schedule[day][hour] = false;
+    snprintf(reply, reply_size, "ERR unknown command '%s'", cmd);
+    return false;
+}
 
-    if (!save_rooms()) {
-        printf("\t\t\t\t\tError: Failed to save changes!\n");
-        rooms[room_index].schedule[day][hour] = true; // Rollback
-        pause_and_clear();
-        return;
+// Commands whose OK reply carries the answer rather than an acknowledgement
+bool is_query_command(const char *line) {
+    static const char *const queries[] = {"search", "free", "stats"};
+    size_t len = strcspn(line, " \t");
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        if (strlen(queries[i]) == len && strncmp(line, queries[i], len) == 0) return true;
     }
+    return false;
+}
 
-    // Log cancellation with current username (admin or regular user)
-    if (!append_booking_record_with_action(room_id, day, hour,
-                                         users[current_user_index].username, 'C')) {
-        printf("\t\t\t\t\tWarning: Cancellation not logged!\n");
+int run_batch(const char *path) {
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!in) {
+        fprintf(stderr, "Cannot open batch file %s: %s\n", path, strerror(errno));
+        return 1;
     }
 
-    // Success message with AM/PM display
-    char ampm_display[10];
-    hour_to_ampm(hour, ampm_display);
-    set_text_color(10); // Green
-    printf("\t\t\t\t\tCancellation successful!\n");
-    printf("\t\t\t\t\tRoom: %d\n", room_id);
-    printf("\t\t\t\t\tDay: %s\n", day_str);
-    printf("\t\t\t\t\tTime: %s\n", ampm_display);
-
-    if (is_admin) {
-        printf("\t\t\t\t\t(Admin cancellation performed)\n");
+    CommandSession session = {0};
+    session.user_index = -1;
+    int commands = 0;
+    int line_no = 0;
+    char line[256];
+    char reply[COMMAND_REPLY_LEN];
+
+    defer_writes = true;
+    double start = now_seconds();
+
+    while (fgets(line, sizeof(line), in)) {
+        line_no++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        const char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0' || *p == '#') continue;
+
+        commands++;
+        bool ok = execute_command(p, &session, reply, sizeof(reply));
+        if (!ok) {
+            session.failed++;
+            fprintf(stderr, "line %d: %s\n", line_no, reply);
+        } else if (is_query_command(p)) {
+            printf("line %d: %s\n", line_no, reply);
+        }
     }
+    if (in != stdin) fclose(in);
+
+    bool flushed = flush_deferred_writes();
+    defer_writes = false;
+    double elapsed = now_seconds() - start;
+
+    printf("Batch complete: %d commands in %.3f s (%.0f commands/s)\n",
+           commands, elapsed, elapsed > 0 ? commands / elapsed : 0.0);
+    printf("  booked %d, cancelled %d, searches %d, rooms added %d, failed %d\n",
+           session.booked, session.cancelled, session.searches, session.rooms_added, session.failed);
+    if (!flushed) {
+        fprintf(stderr, "Error: failed to write changes to disk!\n");
+        return 1;
+    }
+    return session.failed == 0 ? 0 : 2;
+}
 
-    set_text_color(7); // Reset
-    pause_and_clear();
+// Server Mode
+// `slotmap --serve [socket-path|port]` answers the batch command language
+// for many clients at once, over a Unix socket (default slotmap.sock) or
+// TCP on 127.0.0.1 when given a port number. Each connection gets its own
+// thread and must `login <user> <password>` before booking.
+//
+// Slot changes are serialised per room through ROOM_LOCK_STRIPES striped
+// mutexes, never through a global lock: two clients racing for one slot
+// meet in claim_slot()'s compare-and-swap and exactly one wins, while
+// bookings in unrelated rooms proceed in parallel. Searches read the
+// schedule words atomically without locking. The room/user tables are
+// read-only while serving, so add-room is refused.
+
+#ifndef _WIN32
+
+volatile sig_atomic_t server_stop = 0;
+pthread_mutex_t client_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+int *client_fds = NULL;
+int client_fd_count = 0;
+int client_fd_capacity = 0;
+
+void handle_server_signal(int sig) {
+    (void)sig;
+    server_stop = 1;
 }
 
-void add_classroom() {
-    if (current_user_index == -1 || !users[current_user_index].is_admin) {
-        printf("\t\t\t\t\tOnly admins can add classrooms.\n");
-        pause_and_clear();
-        return;
+bool register_client(int fd) {
+    pthread_mutex_lock(&client_registry_lock);
+    bool ok = true;
+    if (client_fd_count == client_fd_capacity) {
+        int new_capacity = client_fd_capacity ? client_fd_capacity * 2 : 16;
+        int *fds = realloc(client_fds, (size_t)new_capacity * sizeof(int));
+        if (fds) {
+            client_fds = fds;
+            client_fd_capacity = new_capacity;
+        } else {
+            ok = false;
+        }
     }
+    if (ok) client_fds[client_fd_count++] = fd;
+    pthread_mutex_unlock(&client_registry_lock);
+    return ok;
+}
 
-    if (room_count >= MAX_ROOMS) {
-        printf("\t\t\t\t\tMaximum room capacity reached.\n");
-        pause_and_clear();
-        return;
+void unregister_client(int fd) {
+    pthread_mutex_lock(&client_registry_lock);
+    for (int i = 0; i < client_fd_count; i++) {
+        if (client_fds[i] == fd) {
+            client_fds[i] = client_fds[--client_fd_count];
+            break;
+        }
     }
+    pthread_mutex_unlock(&client_registry_lock);
+}
 
-    int id;
-    char dept[20], type[10];
-
-    printf("\t\t\t\t\tEnter room ID (3 digits, e.g., 101): ");
-    if (scanf("%d", &id) != 1) {
-        while (getchar() != '\n');
-        printf("\t\t\t\t\tInvalid input.\n");
-        pause_and_clear();
-        return;
+void *serve_client(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    FILE *in = fdopen(fd, "r");
+    FILE *out = in ? fdopen(dup(fd), "w") : NULL;
+    if (!in || !out) {
+        if (in) fclose(in); else close(fd);
+        unregister_client(fd);
+        return NULL;
     }
 
-    if (!validate_room_id(id)) {
-        printf("\t\t\t\t\tInvalid room ID. Must be 3 digits (e.g., 101).\n");
-        pause_and_clear();
-        return;
-    }
+    CommandSession session = {0};
+    session.user_index = -1;
+    char line[256];
+    char reply[COMMAND_REPLY_LEN];
 
-    if (find_room_by_id(id) != -1) {
-        printf("\t\t\t\t\tA room with this ID already exists.\n");
-        pause_and_clear();
-        return;
-    }
+    fprintf(out, "OK slotmap ready\n");
+    fflush(out);
 
-    printf("\t\t\t\t\tEnter department: ");
-    scanf(" %19s", dept);
+    while (fgets(line, sizeof(line), in)) {
+        line[strcspn(line, "\r\n")] = '\0';
 
-    while (1) {
-        printf("\t\t\t\t\tEnter room type (Lab/General): ");
-        scanf(" %9s", type);
-        to_lower_case(type);
-        if (validate_room_type(type))
-            break;
-        printf("\t\t\t\t\tInvalid type. Please enter 'Lab' or 'General'.\n");
+        const char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0') continue;
+        if (strcmp(p, "quit") == 0) break;
+
+        execute_command(p, &session, reply, sizeof(reply));
+        fprintf(out, "%s\n", reply);
+        if (fflush(out) != 0) break;
     }
 
-    rooms[room_count].id = id;
-    strncpy(rooms[room_count].department, dept, sizeof(rooms[room_count].department)-1);
-    rooms[room_count].department[sizeof(rooms[room_count].department)-1] = '\0';
-    strncpy(rooms[room_count].type, type, sizeof(rooms[room_count].type)-1);
-    rooms[room_count].type[sizeof(rooms[room_count].type)-1] = '\0';
+    unregister_client(fd);
+    fclose(out);
+    fclose(in);
+    return NULL;
+}
 
-    for (int d = 0; d < 7; d++)
-        for (int h = 0; h < 24; h++)
-            rooms[room_count].schedule[d][h] = false;
+// Server background writer: checkpoints rooms.wal when appends ask for it,
+// and rewrites dirty tables flush_delay_ms after the first change, so
+// changes made while it waits ride along with the same rewrite
+void *flush_tables_later(void *arg) {
+    (void)arg;
+    bool waiting = false; // a table rewrite is scheduled for `deadline`
+    struct timespec deadline;
+
+    pthread_mutex_lock(&persist_lock);
+    while (!flusher_stop) {
+        if (checkpoint_due) {
+            checkpoint_due = false;
+            pthread_mutex_unlock(&persist_lock);
+            if (!checkpoint_rooms_while_serving()) {
+                fprintf(stderr, "Warning: failed to checkpoint the booking journal!\n");
+            }
+            pthread_mutex_lock(&persist_lock);
+            continue;
+        }
+        if (!users_dirty && !rooms_layout_dirty) {
+            waiting = false;
+            pthread_cond_wait(&persist_wake, &persist_lock);
+            continue;
+        }
 
-    room_count++;
+        if (!waiting) {
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += flush_delay_ms / 1000;
+            deadline.tv_nsec += (long)(flush_delay_ms % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            waiting = true;
+        }
+        if (pthread_cond_timedwait(&persist_wake, &persist_lock, &deadline) != ETIMEDOUT) {
+            continue; // woken early: a checkpoint, a stop, or another change
+        }
 
-    if (!save_rooms()) {
-        printf("\t\t\t\t\tWarning: Failed to save rooms to file!\n");
-    } else {
-        printf("\t\t\t\t\tClassroom added and saved successfully.\n");
+        waiting = false;
+        pthread_mutex_unlock(&persist_lock);
+        if (!flush_dirty_tables()) {
+            fprintf(stderr, "Warning: failed to save changed users or rooms!\n");
+        }
+        pthread_mutex_lock(&persist_lock);
     }
-    pause_and_clear();
+    pthread_mutex_unlock(&persist_lock);
+    return NULL;
 }
 
-const char* day_index_to_name(int day) {
-    if (day >= 0 && day < 7) {
-        return days[day];
+int open_server_socket(const char *endpoint) {
+    bool is_port = endpoint[0] != '\0' && strspn(endpoint, "0123456789") == strlen(endpoint);
+    int fd;
+
+    if (is_port) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd == -1) return -1;
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)atoi(endpoint));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        struct sockaddr_un addr;
+        if (strlen(endpoint) >= sizeof(addr.sun_path)) return -1;
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd == -1) return -1;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, endpoint);
+        unlink(endpoint); // stale socket from a previous run
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+            close(fd);
+            return -1;
+        }
     }
-    return "Invalid";
-}
 
-void view_all_bookings() {
-    set_text_color(14); // Yellow
-    printf("\n\t\t\t\t\tAll Classroom Bookings (Current Status)\n");
-    printf("\t\t\t\t\t--------------------------------------\n");
-    set_text_color(7); // Reset
+    if (listen(fd, SERVER_BACKLOG) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
 
-    bool any_bookings = false;
+int run_server(const char *endpoint) {
+    int listen_fd = open_server_socket(endpoint);
+    if (listen_fd == -1) {
+        fprintf(stderr, "Cannot listen on %s: %s\n", endpoint, strerror(errno));
+        return 1;
+    }
 
-    for (int i = 0; i < room_count; i++) {
-        bool room_has_bookings = false;
+    for (int i = 0; i < ROOM_LOCK_STRIPES; i++) {
+        pthread_mutex_init(&room_locks[i], NULL);
+    }
 
-        // Print room header
-        set_text_color(11); // Cyan
-        printf("\n\t\t\t\t\tRoom %d | %s | %s\n",
-              rooms[i].id, rooms[i].department, rooms[i].type);
-        set_text_color(7); // Reset
+    // No SA_RESTART, so Ctrl+C interrupts accept() and we can shut down cleanly
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_server_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Client threads inherit a mask with these blocked, so the signal
+    // always lands on this thread and interrupts accept()
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+
+    if (!booking_log_fp && !open_booking_log()) {
+        fprintf(stderr, "Cannot open %s\n", BOOKINGS_FILE);
+        close(listen_fd);
+        return 1;
+    }
 
-        // Check each day and hour
-        for (int d = 0; d < 7; d++) {
-            for (int h = 0; h < 24; h++) {
-                if (rooms[i].schedule[d][h]) {
-                    char last_user[50] = {0};
-                    char last_action = 0;
-                    bool found = false;
-                    get_last_slot_action(rooms[i].id, d, h, last_user, &last_action, &found);
+    // Leave a core for book/cancel while logins hash
+    hashing_slots = cpu_count() > 1 ? cpu_count() - 1 : 1;
+    serving = true;
+
+    // Without the flusher, changes are written inline and the WAL is
+    // checkpointed at shutdown
+    pthread_t flusher;
+    sigset_t flusher_mask;
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &flusher_mask);
+    flusher_stop = false;
+    checkpoint_due = false;
+    flusher_running = pthread_create(&flusher, NULL, flush_tables_later, NULL) == 0;
+    pthread_sigmask(SIG_SETMASK, &flusher_mask, NULL);
+
+    printf("Serving on %s (Ctrl+C to stop)\n", endpoint);
+    fflush(stdout);
+
+    while (!server_stop) {
+        int client_fd = accept(listen_fd, NULL, NULL);
+        if (client_fd == -1) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            break;
+        }
 
-                    char time_display[10];
-                    hour_to_ampm(h, time_display);
+        pthread_t thread;
+        sigset_t old_mask;
+        pthread_sigmask(SIG_BLOCK, &stop_signals, &old_mask);
+        bool started = register_client(client_fd) &&
+                       pthread_create(&thread, NULL, serve_client, (void *)(intptr_t)client_fd) == 0;
+        pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
 
-                    if (found && last_action == 'B') {
-                        set_text_color(10); // Green
-                        printf("\t\t\t\t\t  %s at %s - Booked by %s\n",
-                              days[d], time_display, last_user);
-                        set_text_color(7); // Reset
-                        room_has_bookings = true;
-                        any_bookings = true;
-                    }
-                }
-            }
+        if (!started) {
+            unregister_client(client_fd);
+            close(client_fd);
+            continue;
         }
+        pthread_detach(thread);
+    }
 
-        if (!room_has_bookings) {
-            set_text_color(8); // Gray
-            printf("\t\t\t\t\t  (No current bookings)\n");
-            set_text_color(7); // Reset
-        }
+    close(listen_fd);
+    if (strspn(endpoint, "0123456789") != strlen(endpoint)) unlink(endpoint);
+
+    // Wake every client blocked in a read and wait for them to finish
+    pthread_mutex_lock(&client_registry_lock);
+    for (int i = 0; i < client_fd_count; i++) shutdown(client_fds[i], SHUT_RDWR);
+    pthread_mutex_unlock(&client_registry_lock);
+    for (;;) {
+        pthread_mutex_lock(&client_registry_lock);
+        int remaining = client_fd_count;
+        pthread_mutex_unlock(&client_registry_lock);
+        if (remaining == 0) break;
+        usleep(10000);
     }
 
-    if (!any_bookings) {
-        set_text_color(12); // Red
-        printf("\n\t\t\t\t\tNo bookings found in any rooms.\n");
-        set_text_color(7); // Reset
+    // Changes from the last window are written before the server exits
+    if (flusher_running) {
+        pthread_mutex_lock(&persist_lock);
+        flusher_stop = true;
+        pthread_cond_signal(&persist_wake);
+        pthread_mutex_unlock(&persist_lock);
+        pthread_join(flusher, NULL);
+        flusher_running = false;
+    }
+    if (!flush_dirty_tables()) {
+        fprintf(stderr, "Warning: failed to save changed users or rooms!\n");
     }
 
-    // Display booking history
-    set_text_color(14); // Yellow
-    printf("\n\n\t\t\t\t\tBooking History Log\n");
-    printf("\t\t\t\t\t-------------------\n");
-    set_text_color(7); // Reset
+    serving = false;
+    printf("Server stopped.\n");
+    return 0;
+}
 
-    FILE *fp = fopen(BOOKINGS_FILE, "r");
-    if (fp) {
-        char line[256];
-        int record_count = 0;
+#else
 
-        while (fgets(line, sizeof(line), fp)) {
-            BookingRecord rec;
-            if (sscanf(line, "%d %d %d %c %49s",
-                      &rec.room_id,
-                      &rec.day,
-                      &rec.hour,
-                      &rec.action,
-                      rec.username) == 5) {
-                char time_display[10];
-                hour_to_ampm(rec.hour, time_display);
-
-                if (rec.action == 'B') {
-                    set_text_color(10); // Green
-                    printf("\t\t\t\t\t[BOOKED] ");
-                } else {
-                    set_text_color(12); // Red
-                    printf("\t\t\t\t\t[CANCELLED] ");
-                }
+int run_server(const char *endpoint) {
+    (void)endpoint;
+    fprintf(stderr, "Server mode is only available on POSIX systems.\n");
+    return 1;
+}
 
-                printf("Room %d | %s at %s | by %s\n",
-                      rec.room_id, days[rec.day], time_display, rec.username);
-                set_text_color(7); // Reset
-                record_count++;
-            }
-        }
-        fclose(fp);
+#endif
 
-        if (record_count == 0) {
-            set_text_color(8); // Gray
-            printf("\t\t\t\t\tNo booking history records found.\n");
-            set_text_color(7); // Reset
-        }
-    } else {
-        set_text_color(12); // Red
-        printf("\t\t\t\t\tCould not open booking history file.\n");
-        set_text_color(7); // Reset
-    }
+// Benchmark Mode
+// `slotmap --bench [rooms] [users] [history]` builds a synthetic campus in
+// bench_* files next to the real data, times the storage, lookup, search,
+// booking and listing paths with terminal I/O stripped out, and reports
+// throughput and latency percentiles. The real data files are untouched.
+
+uint64_t bench_rng_state = 0x9E3779B97F4A7C15ull;
+
+uint32_t bench_rand() {
+    uint64_t x = bench_rng_state; // xorshift64*, fixed seed so runs compare
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    bench_rng_state = x;
+    return (uint32_t)((x * 2685821657736338717ull) >> 32);
+}
 
-    pause_and_clear();
+int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
 }
 
-void my_bookings() {
-    if (current_user_index == -1) {
-        printf("\t\t\t\t\tYou must be logged in to view your bookings.\n");
-        pause_and_clear();
-        return;
+// Prints ops/sec and latency percentiles; sorts samples in place
+void report_latencies(const char *name, double *samples, int count) {
+    if (count == 0) return;
+
+    double total = 0;
+    for (int i = 0; i < count; i++) total += samples[i];
+    qsort(samples, (size_t)count, sizeof(double), compare_doubles);
+
+    #define PCT(p) (samples[(int)((count - 1) * (p))] * 1e6)
+    printf("%-24s %8d ops %12.0f ops/s   p50 %10.2f us  p90 %10.2f us  p99 %10.2f us  max %10.2f us\n",
+           name, count, total > 0 ? count / total : 0.0,
+           PCT(0.50), PCT(0.90), PCT(0.99), PCT(1.0));
+    #undef PCT
+}
+
+void generate_bench_campus(int n_rooms, int n_users, int n_history) {
+    static const char *departments[] = {"CSE", "EEE", "ME", "CE", "BBA", "ENG", "LAW", "ARCH"};
+
+    room_count = 0;
+    user_count = 0;
+    reserve_rooms(n_rooms);
+    reserve_users(n_users);
+    rebuild_room_index();
+    rebuild_room_groups();
+
+    // 50 rooms per floor, numbered like real ones: 101-150, 201-250, ... 1201-1250
+    for (int i = 0; i < n_rooms; i++) {
+        create_classroom((i / 50 + 1) * 100 + i % 50 + 1, departments[i % 8],
+                         (i % 3 == 0) ? "lab" : "general");
     }
 
-    const char *username = users[current_user_index].username;
-    bool found_any = false;
+    for (int i = 0; i < n_users; i++) {
+        snprintf(users[i].username, sizeof(users[i].username), "user%d", i);
+        snprintf(users[i].password, sizeof(users[i].password), "pw%d", i);
+        users[i].is_admin = (i == 0);
+    }
+    user_count = n_users;
+    rebuild_user_index();
+
+    // Random book/cancel history that stays consistent with the schedule
+    close_booking_log();
+    remove(BOOKINGS_FILE);
+    defer_writes = true;
+    for (int k = 0; k < n_history; k++) {
+        int r = (int)(bench_rand() % (uint32_t)n_rooms);
+        int d = (int)(bench_rand() % 7);
+        int h = (int)(bench_rand() % 24);
+        bool booked = slot_is_booked(&rooms[r], d, h);
+        set_slot_booked(&rooms[r], d, h, !booked);
+        append_booking_record_with_action(rooms[r].id, d, h,
+                                          (int)(bench_rand() % (uint32_t)n_users),
+                                          booked ? 'C' : 'B');
+    }
+    defer_writes = false;
+    if (booking_log_fp) fflush(booking_log_fp);
 
-    // Display current active bookings
-    set_text_color(14); // Yellow
-    printf("\n\t\t\t\t\tYour Current Active Bookings (%s)\n", username);
-    printf("\t\t\t\t\t-------------------------------\n");
-    set_text_color(7); // Reset
+    save_rooms();
+    save_users();
+}
+
+// The campus in the legacy rooms.txt layout, for timing the text scanner
+bool write_bench_rooms_text() {
+    FILE *fp = fopen(ROOMS_FILE, "w");
+    if (!fp) return false;
 
+    fprintf(fp, "%d\n", room_count);
     for (int i = 0; i < room_count; i++) {
+        fprintf(fp, "%d %s %s\n", rooms[i].id, rooms[i].department, rooms[i].type);
         for (int d = 0; d < 7; d++) {
             for (int h = 0; h < 24; h++) {
-                if (rooms[i].schedule[d][h]) {
-                    char last_user[50] = {0};
-                    char last_action = 0;
-                    bool found = false;
-                    get_last_slot_action(rooms[i].id, d, h, last_user, &last_action, &found);
-
-                    if (found && last_action == 'B' && strcmp(last_user, username) == 0) {
-                        char time_display[10];
-                        hour_to_ampm(h, time_display);
-
-                        set_text_color(11); // Cyan
-                        printf("\t\t\t\t\tRoom %d | %s | %s\n",
-                              rooms[i].id, days[d], time_display);
-                        set_text_color(7); // Reset
-                        found_any = true;
-                    }
-                }
+                fprintf(fp, "%d ", slot_is_booked(&rooms[i], d, h) ? 1 : 0);
             }
+            fprintf(fp, "\n");
         }
     }
+    return fclose(fp) == 0;
+}
 
-    if (!found_any) {
-        set_text_color(8); // Gray
-        printf("\t\t\t\t\tNo active bookings found.\n");
-        set_text_color(7); // Reset
+int run_benchmarks(int n_rooms, int n_users, int n_history) {
+    if (n_rooms < 1 || n_users < 1 || n_history < 0) {
+        fprintf(stderr, "Benchmark sizes must be positive.\n");
+        return 1;
     }
 
-    // Display complete booking history
-    set_text_color(14); // Yellow
-    printf("\n\n\t\t\t\t\tYour Complete Booking History\n");
-    printf("\t\t\t\t\t---------------------------\n");
-    set_text_color(7); // Reset
-
-    FILE *fp = fopen(BOOKINGS_FILE, "r");
-    if (fp) {
-        found_any = false;
-        char line[256];
-
-        // First pass: Show all user's bookings
-        while (fgets(line, sizeof(line), fp)) {
-            BookingRecord rec;
-            if (sscanf(line, "%d %d %d %c %49s",
-                      &rec.room_id, &rec.day, &rec.hour, &rec.action, rec.username) == 5) {
-                if (strcmp(rec.username, username) == 0) {
-                    found_any = true;
-                    char time_display[10];
-                    hour_to_ampm(rec.hour, time_display);
+    USERS_FILE = "bench_users.txt";
+    ROOMS_FILE = "bench_rooms.txt";
+    BOOKINGS_TEXT_FILE = "bench_bookings.txt";
+    BOOKINGS_NAMES_FILE = "bench_bookings.names";
+    ROOMS_DB_FILE = "bench_rooms.dat";
+    ROOMS_WAL_FILE = "bench_rooms.wal";
+    ROOMS_WAL_OLD_FILE = "bench_rooms.wal.old";
+    BOOKINGS_FILE = "bench_bookings.dat";
+    BOOKINGS_ARCHIVE_PREFIX = "bench_bookings";
 
-                    if (rec.action == 'B') {
-                        set_text_color(10); // Green
-                        printf("\t\t\t\t\t[BOOKED] ");
-                    } else {
-                        set_text_color(12); // Red
-                        printf("\t\t\t\t\t[CANCELLED] ");
-                    }
+#ifdef _WIN32
+    FILE *sink = fopen("NUL", "w");
+#else
+    FILE *sink = fopen("/dev/null", "w");
+#endif
+    int max_samples = 100000;
+    double *samples = malloc((size_t)max_samples * sizeof(double));
+    if (!sink || !samples) {
+        fprintf(stderr, "Cannot set up benchmark.\n");
+        return 1;
+    }
+    Screen screen; // listings render here and flush to the sink
+    screen_open(&screen, sink);
+
+    printf("Generating campus: %d rooms, %d users, %d history records...\n",
+           n_rooms, n_users, n_history);
+    double t0 = now_seconds();
+    generate_bench_campus(n_rooms, n_users, n_history);
+    printf("Generated in %.3f s\n\n", now_seconds() - t0);
+
+    int n;
+    char line[128], reply[COMMAND_REPLY_LEN];
+
+    n = 20;
+    for (int i = 0; i < n; i++) {
+        double t = now_seconds();
+        load_rooms();
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("load_rooms", samples, n);
 
-                    printf("Room %d | %s at %s", rec.room_id, days[rec.day], time_display);
+    n = 20;
+    for (int i = 0; i < n; i++) {
+        double t = now_seconds();
+        save_rooms();
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("save_rooms", samples, n);
 
-                    if (rec.action == 'C') {
-                        printf(" (by you)");
-                    }
-                    printf("\n");
-                    set_text_color(7); // Reset
-                }
-            }
-        }
+    n = 5;
+    for (int i = 0; i < n; i++) {
+        double t = now_seconds();
+        load_users();
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("parse users.txt", samples, n);
 
-        // Second pass: Show admin cancellations of user's bookings
-        rewind(fp);
-        while (fgets(line, sizeof(line), fp)) {
-            BookingRecord rec;
-            if (sscanf(line, "%d %d %d %c %49s",
-                      &rec.room_id, &rec.day, &rec.hour, &rec.action, rec.username) == 5) {
-                if (rec.action == 'C' && strcmp(rec.username, username) != 0) {
-                    // Check if this cancellation affects one of the user's bookings
-                    char original_booker[50] = {0};
-                    char original_action = 0;
-                    bool booking_found = false;
-                    get_last_slot_action(rec.room_id, rec.day, rec.hour,
-                                       original_booker, &original_action, &booking_found);
-
-                    if (booking_found && original_action == 'B' &&
-                        strcmp(original_booker, username) == 0) {
-                        found_any = true;
-                        char time_display[10];
-                        hour_to_ampm(rec.hour, time_display);
-
-                        set_text_color(12); // Red
-                        printf("\t\t\t\t\t[CANCELLED] Room %d | %s at %s (by admin)\n",
-                              rec.room_id, days[rec.day], time_display);
-                        set_text_color(7); // Reset
-                    }
-                }
-            }
-        }
+    n = write_bench_rooms_text() ? 5 : 0;
+    for (int i = 0; i < n; i++) {
+        double t = now_seconds();
+        load_rooms_text();
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("parse rooms.txt", samples, n);
 
-        fclose(fp);
+    n = 5;
+    for (int i = 0; i < n; i++) {
+        double t = now_seconds();
+        build_slot_history_index();
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("history replay", samples, n);
 
-        if (!found_any) {
-            set_text_color(8); // Gray
-            printf("\t\t\t\t\tNo booking history found.\n");
-            set_text_color(7); // Reset
+    n = export_booking_log(BOOKINGS_TEXT_FILE, 0) == 0 ? 5 : 0;
+    long text_records = 0;
+    for (int i = 0; i < n; i++) {
+        TextScanner scan;
+        BookingRecord rec;
+        text_records = 0;
+        double t = now_seconds();
+        if (open_text_scanner(&scan, BOOKINGS_TEXT_FILE)) {
+            while (next_booking_text_record(&scan, &rec)) text_records++;
+            close_text_scanner(&scan);
         }
-    } else {
-        set_text_color(12); // Red
-        printf("\t\t\t\t\tCould not open booking history file.\n");
-        set_text_color(7); // Reset
+        samples[i] = now_seconds() - t;
     }
-
-    pause_and_clear();
+    report_latencies("parse bookings.txt", samples, n);
+    if (n > 0) printf("  %ld text records per pass\n", text_records);
+
+    n = max_samples;
+    for (int i = 0; i < n; i++) {
+        int r = (int)(bench_rand() % (uint32_t)room_count);
+        int d = (int)(bench_rand() % 7), h = (int)(bench_rand() % 24);
+        char who[50], action;
+        bool found;
+        double t = now_seconds();
+        get_last_slot_action(rooms[r].id, d, h, who, &action, &found);
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("get_last_slot_action", samples, n);
+
+    CommandSession session = {0};
+    session.user_index = 0;
+    n = 10000;
+    for (int i = 0; i < n; i++) {
+        int r = (int)(bench_rand() % (uint32_t)room_count);
+        snprintf(line, sizeof(line), "search %s %s %dAM %s", rooms[r].department,
+                 days[bench_rand() % 7], 1 + (int)(bench_rand() % 12), rooms[r].type);
+        double t = now_seconds();
+        execute_command(line, &session, reply, sizeof(reply));
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("search", samples, n);
+
+    n = 2000;
+    for (int i = 0; i < n; i++) {
+        WindowQuery query = {-1, -1, -1, 0x7F, 1 + (int)(bench_rand() % 4), true};
+        FreeWindow windows[10];
+        double t = now_seconds();
+        find_free_windows(&query, windows, 10);
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("free window (week)", samples, n);
+
+    // Book then cancel the same free slot so the campus stays unchanged
+    n = 5000;
+    int pairs = 0;
+    double *cancel_samples = malloc((size_t)n * sizeof(double));
+    for (int i = 0; cancel_samples && i < n; i++) {
+        int r = (int)(bench_rand() % (uint32_t)room_count);
+        int d = (int)(bench_rand() % 7), h = (int)(bench_rand() % 24);
+        if (slot_is_booked(&rooms[r], d, h)) continue;
+        int u = (int)(bench_rand() % (uint32_t)user_count);
+
+        double t = now_seconds();
+        book_slot_as(r, d, h, u);
+        double t1 = now_seconds();
+        cancel_slot_as(r, d, h, u);
+        double t2 = now_seconds();
+
+        samples[pairs] = t1 - t;
+        cancel_samples[pairs] = t2 - t1;
+        pairs++;
+    }
+    report_latencies("book_slot", samples, pairs);
+    if (cancel_samples) report_latencies("cancel_booking", cancel_samples, pairs);
+    free(cancel_samples);
+
+    n = 5;
+    for (int i = 0; i < n; i++) {
+        double t = now_seconds();
+        print_all_bookings(&screen);
+        screen_flush(&screen, sink, false);
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("view_all_bookings", samples, n);
+
+    n = 20;
+    for (int i = 0; i < n; i++) {
+        int u = (int)(bench_rand() % (uint32_t)user_count);
+        double t = now_seconds();
+        print_my_bookings(&screen, u);
+        screen_flush(&screen, sink, false);
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("my_bookings", samples, n);
+
+    n = 20;
+    for (int i = 0; i < n; i++) {
+        CampusStats stats;
+        double t = now_seconds();
+        collect_campus_stats(&stats);
+        samples[i] = now_seconds() - t;
+        free_campus_stats(&stats);
+    }
+    report_latencies("analytics", samples, n);
+
+    // Password cost: one login verifies one hash at the configured iterations,
+    // about 0.2 s at the default cost
+    n = 5;
+    char hashed[PASSWORD_HASH_LEN];
+    for (int i = 0; i < n; i++) {
+        double t = now_seconds();
+        hash_password("bench-password", password_iterations, hashed, sizeof(hashed));
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("password hash", samples, n);
+    for (int i = 0; i < n; i++) {
+        bool rehash;
+        double t = now_seconds();
+        verify_password(hashed, "bench-password", &rehash);
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("login verify", samples, n);
+    // report_latencies() left the samples sorted
+    double per_core = samples[n / 2] > 0 ? 1.0 / samples[n / 2] : 0.0;
+    int hashers = cpu_count() > 1 ? cpu_count() - 1 : 1;
+    printf("  %d iterations: about %.0f logins/s per core\n", password_iterations, per_core);
+    // --serve hashes on all but one core; the rest of the burst queues
+    printf("  --serve: %d hashing cores, a burst of 500 logins clears in about %.1f s\n",
+           hashers, per_core > 0 ? 500.0 / (per_core * hashers) : 0.0);
+
+    double t = now_seconds();
+    long archived = 0, kept = 0;
+    compact_booking_log(&archived, &kept);
+    samples[0] = now_seconds() - t;
+    report_latencies("compact", samples, 1);
+    printf("  archived %ld records, kept %ld\n", archived, kept);
+
+    n = 5;
+    for (int i = 0; i < n; i++) {
+        t = now_seconds();
+        print_archived_history(&screen, -1);
+        screen_flush(&screen, sink, false);
+        samples[i] = now_seconds() - t;
+    }
+    report_latencies("archived history", samples, n);
+
+    close_rooms_wal();
+    close_booking_log();
+    screen_close(&screen);
+    fclose(sink);
+    free(samples);
+
+    remove(USERS_FILE);
+    remove(ROOMS_FILE);
+    remove(BOOKINGS_TEXT_FILE);
+    remove(BOOKINGS_NAMES_FILE);
+    remove(ROOMS_DB_FILE);
+    remove(ROOMS_WAL_FILE);
+    remove(ROOMS_WAL_OLD_FILE);
+    remove(BOOKINGS_FILE);
+    for (int segment = 1; segment <= archive_segments; segment++) {
+        char path[FILENAME_MAX];
+        archive_path(segment, path, sizeof(path));
+        remove(path);
+    }
+    return 0;
 }
 
 void user_menu() {
@@ -1248,13 +7895,14 @@ void user_menu() {
         printf("\t\t\t\t\t2. Book Slot\n");
         printf("\t\t\t\t\t3. Cancel Booking\n");
         printf("\t\t\t\t\t4. My Bookings\n");
-        printf("\t\t\t\t\t5. Logout\n");
+        printf("\t\t\t\t\t5. Find Free Window\n");
+        printf("\t\t\t\t\t6. Logout\n");
         printf("\t\t\t\t\t0. Back to Main Menu\n");
         printf("\t\t\t\t\tEnter your choice: ");
 
-        int choice;
-        if (scanf("%d", &choice) != 1) {
-            while (getchar() != '\n');
+        int choice = read_menu_choice();
+        if (choice == -2) choice = 0; // end of input: back to the main menu
+        if (choice < 0) {
             printf("\t\t\t\t\tInvalid input.\n");
             pause_and_clear();
             continue;
@@ -1269,7 +7917,9 @@ void user_menu() {
             break;
             case 4: my_bookings();
             break;
-            case 5:
+            case 5: find_free_window();
+            break;
+            case 6:
                 printf("\t\t\t\t\tLogging out...\n");
                 current_user_index = -1;
                 pause_and_clear();
@@ -1297,13 +7947,16 @@ void admin_menu() {
         printf("\t\t\t\t\t3. Cancel Booking\n");
         printf("\t\t\t\t\t4. Add Classroom\n");
         printf("\t\t\t\t\t5. View All Bookings\n");
-        printf("\t\t\t\t\t6. Logout\n");
+        printf("\t\t\t\t\t6. Compact Booking Log\n");
+        printf("\t\t\t\t\t7. Find Free Window\n");
+        printf("\t\t\t\t\t8. Utilization Report\n");
+        printf("\t\t\t\t\t9. Logout\n");
         printf("\t\t\t\t\t0. Back to Main Menu\n");
         printf("\t\t\t\t\tEnter your choice: ");
 
-        int choice;
-        if (scanf("%d", &choice) != 1) {
-            while (getchar() != '\n');
+        int choice = read_menu_choice();
+        if (choice == -2) choice = 0; // end of input: back to the main menu
+        if (choice < 0) {
             printf("\t\t\t\t\tInvalid input.\n");
             pause_and_clear();
             continue;
@@ -1320,7 +7973,13 @@ void admin_menu() {
             break;
             case 5: view_all_bookings();
             break;
-            case 6:
+            case 6: compact_history();
+            break;
+            case 7: find_free_window();
+            break;
+            case 8: utilization_report();
+            break;
+            case 9:
                 printf("\t\t\t\t\tLogging out...\n");
                 current_user_index = -1;
                 pause_and_clear();
@@ -1333,7 +7992,82 @@ void admin_menu() {
     }
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    // --hash-cost, --slot-minutes, --threads and --flush-delay apply to whatever mode follows them
+    while (argc > 2 && (strcmp(argv[1], "--hash-cost") == 0 || strcmp(argv[1], "--slot-minutes") == 0 ||
+                        strcmp(argv[1], "--threads") == 0 || strcmp(argv[1], "--flush-delay") == 0)) {
+        if (strcmp(argv[1], "--hash-cost") == 0) {
+            password_iterations = atoi(argv[2]);
+            if (password_iterations < PASSWORD_MIN_ITERATIONS) {
+                fprintf(stderr, "Hash cost must be at least %d iterations.\n", PASSWORD_MIN_ITERATIONS);
+                return 1;
+            }
+        } else if (strcmp(argv[1], "--flush-delay") == 0) {
+            flush_delay_ms = atoi(argv[2]);
+            if (flush_delay_ms < 0 || flush_delay_ms > MAX_FLUSH_DELAY_MS) {
+                fprintf(stderr, "Flush delay must be between 0 and %d ms.\n", MAX_FLUSH_DELAY_MS);
+                return 1;
+            }
+        } else if (strcmp(argv[1], "--threads") == 0) {
+            worker_threads = atoi(argv[2]);
+            if (worker_threads < 1 || worker_threads > MAX_WORKER_THREADS) {
+                fprintf(stderr, "Threads must be between 1 and %d.\n", MAX_WORKER_THREADS);
+                return 1;
+            }
+        } else {
+            slot_minutes = atoi(argv[2]);
+            if (slot_minutes != 15 && slot_minutes != 30 && slot_minutes != 60) {
+                fprintf(stderr, "Slot length must be 15, 30 or 60 minutes.\n");
+                return 1;
+            }
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc > 1) {
+        if (argc == 3 && strcmp(argv[1], "--batch") == 0) {
+            ensure_data_loaded_or_initialized();
+            int status = run_batch(argv[2]);
+            close_rooms_wal();
+            close_booking_log();
+            return status;
+        }
+        if ((argc == 2 || argc == 3) && strcmp(argv[1], "--serve") == 0) {
+            ensure_data_loaded_or_initialized();
+            int status = run_server(argc == 3 ? argv[2] : "slotmap.sock");
+            close_rooms_wal();
+            close_booking_log();
+            return status;
+        }
+        if ((argc == 3 || argc == 4) && strcmp(argv[1], "--export-log") == 0) {
+            ensure_data_loaded_or_initialized();
+            int status = export_booking_log(argv[2], argc == 4 ? atoi(argv[3]) : 0);
+            close_rooms_wal();
+            close_booking_log();
+            return status;
+        }
+        if ((argc == 2 || argc == 3) && strcmp(argv[1], "--analytics") == 0) {
+            ensure_data_loaded_or_initialized();
+            int status = run_analytics(argc == 3 ? argv[2] : NULL);
+            close_rooms_wal();
+            close_booking_log();
+            return status;
+        }
+        if (argc <= 5 && strcmp(argv[1], "--bench") == 0) {
+            return run_benchmarks(argc > 2 ? atoi(argv[2]) : 1000,
+                                  argc > 3 ? atoi(argv[3]) : 5000,
+                                  argc > 4 ? atoi(argv[4]) : 200000);
+        }
+        fprintf(stderr, "Usage: %s [--hash-cost <iterations>] [--slot-minutes <15|30|60>] [--threads <n>]\n"
+                        "          [--flush-delay <ms>] [--batch <file|->] [--serve [socket-path|port]]\n"
+                        "       %s --export-log <file|-> [days]\n"
+                        "       %s --analytics [report.csv]\n"
+                        "       %s --bench [rooms] [users] [history]\n", argv[0], argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
     ensure_data_loaded_or_initialized();
 
     while (1) {
@@ -1362,9 +8096,9 @@ int main() {
         printf("\t\t\t\t\t3. Exit\n");
         printf("\t\t\t\t\tEnter your choice: ");
 
-        int choice;
-        if (scanf("%d", &choice) != 1) {
-            while (getchar() != '\n');
+        int choice = read_menu_choice();
+        if (choice == -2) choice = 3; // end of input: exit
+        if (choice < 0) {
             printf("\t\t\t\t\tInvalid input.\n");
             pause_and_clear();
             continue;
@@ -1383,6 +8117,9 @@ int main() {
                 break;
             case 3:
                 printf("\t\t\t\t\tExiting program...\n");
+                set_text_color(7); // leave the terminal in its default color
+                close_rooms_wal();
+                close_booking_log();
                 exit(0);
             default:
                 printf("\t\t\t\t\tInvalid choice. Please try again.\n");